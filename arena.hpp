@@ -0,0 +1,148 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace term
+{
+
+  /**
+   * @brief Bump allocator for the temporaries of one frame
+   *
+   * A std::pmr::memory_resource: give it to std::pmr::string or
+   * std::pmr::vector. Deallocation does nothing, all the memory is released
+   * at once by reset() at the start of the next frame. A frame needing more
+   * than the block gets the rest from the upstream resource and reset()
+   * grows the block to the peak, so from then on frames do not call the
+   * global allocator. Not thread safe.
+   */
+  class FrameArena : public std::pmr::memory_resource
+  {
+    public:
+      /**
+       * @brief Create an arena
+       *
+       * @param capacity initial size of the block in bytes
+       * @param upstream resource of the block and of the overflow
+       */
+      explicit FrameArena(const std::size_t capacity = 64 * 1024,
+			  std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+	  : upstream(upstream)
+      {
+	grow(capacity);
+      }
+
+      ~FrameArena()
+      {
+	release();
+	upstream->deallocate(block, capacity, alignof(std::max_align_t));
+      }
+
+      FrameArena(const FrameArena&) = delete;
+      FrameArena& operator=(const FrameArena&) = delete;
+
+      /**
+       * @brief Free all the memory of the frame, the objects using it must
+       * be gone
+       */
+      void reset()
+      {
+	const std::size_t peak = used + overflowed;
+	release();
+	if (peak > capacity)
+	{
+	  grow(peak + peak / 2);
+	}
+	used = 0;
+      }
+
+      /** @brief Bytes allocated since reset() */
+      std::size_t bytes() const
+      {
+	return used + overflowed;
+      }
+
+      /** @brief Size of the block */
+      std::size_t size() const
+      {
+	return capacity;
+      }
+
+      /** @brief Allocations of the frame which did not fit in the block */
+      std::size_t overflows() const
+      {
+	return overflow.size();
+      }
+
+    private:
+      struct Chunk
+      {
+	void *p;
+	std::size_t bytes;
+	std::size_t alignment;
+      };
+
+      std::pmr::memory_resource *upstream;
+      std::byte *block = nullptr;
+      std::size_t capacity = 0;
+      std::size_t used = 0;
+      std::size_t overflowed = 0;
+      std::vector<Chunk> overflow;
+
+      void grow(const std::size_t bytes)
+      {
+	if (block != nullptr)
+	{
+	  upstream->deallocate(block, capacity, alignof(std::max_align_t));
+	  block = nullptr;
+	  capacity = 0;
+	}
+	block = static_cast<std::byte*>(upstream->allocate(bytes, alignof(std::max_align_t)));
+	capacity = bytes;
+      }
+
+      void release()
+      {
+	for (const Chunk& chunk : overflow)
+	{
+	  if (chunk.p != nullptr)
+	  {
+	    upstream->deallocate(chunk.p, chunk.bytes, chunk.alignment);
+	  }
+	}
+	overflow.clear();
+	overflowed = 0;
+      }
+
+      void *do_allocate(const std::size_t bytes, const std::size_t alignment) override
+      {
+	void *p = block + used;
+	std::size_t space = capacity - used;
+	if (std::align(alignment, bytes, p, space) != nullptr)
+	{
+	  used = capacity - space + bytes;
+	  return p;
+	}
+	// Recorded first, so an allocation failure leaks nothing
+	overflow.push_back(Chunk { nullptr, bytes, alignment });
+	overflow.back().p = upstream->allocate(bytes, alignment);
+	overflowed += bytes;
+	return overflow.back().p;
+      }
+
+      void do_deallocate(void*, std::size_t, std::size_t) override
+      {
+      }
+
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+      {
+	return this == &other;
+      }
+  };
+
+}
+
+#endif // ARENA_HPP
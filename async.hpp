@@ -0,0 +1,504 @@
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "term.hpp"
+#include "trace.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Coroutine started at once and destroyed when it returns
+   *
+   * Tasks run until their first co_await, then are resumed by the reactor.
+   * An exception escaping a task terminates the program.
+   */
+  struct Task
+  {
+      struct promise_type
+      {
+	  Task get_return_object()
+	  {
+	    return Task();
+	  }
+
+	  std::suspend_never initial_suspend() noexcept
+	  {
+	    return {};
+	  }
+
+	  std::suspend_never final_suspend() noexcept
+	  {
+	    return {};
+	  }
+
+	  void return_void()
+	  {
+	  }
+
+	  void unhandled_exception()
+	  {
+	    std::terminate();
+	  }
+      };
+  };
+
+  /**
+   * @brief Block SIGWINCH so that it is only received by a Reactor signalfd
+   *
+   * The mask is per thread and inherited by the threads created afterwards.
+   * Call it in main() before starting any thread, e.g. a WorkPool, when the
+   * program waits for resized(): otherwise the kernel may deliver the
+   * signal to another thread, which handles or ignores it, and resized()
+   * is never resumed.
+   */
+  inline void blockResizeSignal()
+  {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGWINCH);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+  }
+
+  /**
+   * @brief Single threaded event loop resuming coroutines
+   *
+   * One epoll descriptor multiplexes stdin, a timerfd armed to the earliest
+   * timer and a signalfd receiving SIGWINCH, so the thread sleeps in a
+   * single epoll_wait() when idle. Keys read while no task waits for one are
+   * queued. Stdin must be in non canonical mode, see initConsole(). Resizes
+   * are only seen if no other thread has SIGWINCH unblocked, see
+   * blockResizeSignal().
+   *
+   * Use one reactor per thread, see reactor(). Not thread safe.
+   */
+  class Reactor
+  {
+    public:
+      using Clock = std::chrono::steady_clock;
+
+      /** @brief Awaitable of the next key */
+      struct KeyAwaiter
+      {
+	  Reactor& reactor;
+	  KeyEvent key;
+	  std::coroutine_handle<> handle;
+
+	  bool await_ready()
+	  {
+	    if (reactor.keys.empty())
+	    {
+	      return false;
+	    }
+	    key = reactor.keys.front();
+	    reactor.keys.pop_front();
+	    return true;
+	  }
+
+	  void await_suspend(std::coroutine_handle<> h)
+	  {
+	    handle = h;
+	    reactor.watchInput();
+	    reactor.keyWaiters.push_back(this);
+	  }
+
+	  KeyEvent await_resume()
+	  {
+	    return key;
+	  }
+      };
+
+      /** @brief Awaitable of a time point */
+      struct TimerAwaiter
+      {
+	  Reactor& reactor;
+	  Clock::time_point deadline;
+
+	  bool await_ready()
+	  {
+	    return deadline <= Clock::now();
+	  }
+
+	  void await_suspend(std::coroutine_handle<> h)
+	  {
+	    reactor.addTimer(deadline, h);
+	  }
+
+	  void await_resume()
+	  {
+	  }
+      };
+
+      /** @brief Awaitable of the next terminal resize */
+      struct ResizeAwaiter
+      {
+	  Reactor& reactor;
+	  Size size;
+	  std::coroutine_handle<> handle;
+
+	  bool await_ready()
+	  {
+	    return false;
+	  }
+
+	  void await_suspend(std::coroutine_handle<> h)
+	  {
+	    handle = h;
+	    reactor.watchResize();
+	    reactor.resizeWaiters.push_back(this);
+	  }
+
+	  Size await_resume()
+	  {
+	    return size;
+	  }
+      };
+
+      Reactor()
+      {
+	epoll = epoll_create1(EPOLL_CLOEXEC);
+	timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	add(timer);
+      }
+
+      /** @brief Close the descriptors. Tasks still waiting are never resumed */
+      ~Reactor()
+      {
+	if (signals >= 0)
+	{
+	  ::close(signals);
+	}
+	::close(timer);
+	::close(epoll);
+      }
+
+      Reactor(const Reactor&) = delete;
+      Reactor& operator=(const Reactor&) = delete;
+
+      KeyAwaiter nextKey()
+      {
+	return KeyAwaiter { *this, KeyEvent(), nullptr };
+      }
+
+      TimerAwaiter sleepFor(const Clock::duration duration)
+      {
+	return TimerAwaiter { *this, Clock::now() + duration };
+      }
+
+      TimerAwaiter sleepUntil(const Clock::time_point deadline)
+      {
+	return TimerAwaiter { *this, deadline };
+      }
+
+      ResizeAwaiter resized()
+      {
+	return ResizeAwaiter { *this, Size(), nullptr };
+      }
+
+      /**
+       * @brief Resume waiting tasks as their events arrive
+       *
+       * Returns when no task waits anymore, after stop(), or when waiting
+       * for events fails.
+       *
+       * @return False on error, see errno
+       */
+      bool run()
+      {
+	stopped = false;
+	while (!stopped && (!keyWaiters.empty() || !resizeWaiters.empty() || !timers.empty()))
+	{
+	  if (!poll(-1))
+	  {
+	    return false;
+	  }
+	}
+	return true;
+      }
+
+      /**
+       * @brief Wait once for events and resume the tasks concerned
+       *
+       * @param timeout maximum wait in milliseconds, -1 for no limit
+       * @return False on error
+       */
+      bool poll(const int timeout)
+      {
+	epoll_event events[8];
+	const int n = epoll_wait(epoll, events, 8, timeout);
+	if (n < 0)
+	{
+	  return errno == EINTR;
+	}
+	for (int i = 0; i < n; ++i)
+	{
+	  const int fd = events[i].data.fd;
+	  if (fd == timer)
+	  {
+	    std::uint64_t expirations;
+	    while (::read(timer, &expirations, sizeof(expirations)) > 0)
+	    {
+	    }
+	    expire();
+	  }
+	  else if (fd == signals)
+	  {
+	    signalfd_siginfo info;
+	    bool resize = false;
+	    while (::read(signals, &info, sizeof(info)) == sizeof(info))
+	    {
+	      resize = resize || info.ssi_signo == SIGWINCH;
+	    }
+	    if (resize)
+	    {
+	      notifyResize();
+	    }
+	  }
+	  else if (fd == STDIN_FILENO)
+	  {
+	    readInput();
+	  }
+	}
+	return true;
+      }
+
+      /** @brief Make run() return after the current events */
+      void stop()
+      {
+	stopped = true;
+      }
+
+    private:
+      struct Timer
+      {
+	  Clock::time_point deadline;
+	  std::uint64_t sequence;
+	  std::coroutine_handle<> handle;
+
+	  bool operator >(const Timer& t) const
+	  {
+	    return deadline != t.deadline ? deadline > t.deadline : sequence > t.sequence;
+	  }
+      };
+
+      int epoll = -1;
+      int timer = -1;
+      int signals = -1;
+      bool watchingInput = false;
+      bool stopped = false;
+      std::uint64_t sequence = 0;
+      std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+      std::deque<KeyAwaiter*> keyWaiters;
+      std::deque<ResizeAwaiter*> resizeWaiters;
+      std::deque<KeyEvent> keys;
+      std::string input;
+      std::vector<std::coroutine_handle<>> ready;
+
+      void add(const int fd)
+      {
+	epoll_event event {};
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+      }
+
+      void watchInput()
+      {
+	if (!watchingInput)
+	{
+	  add(STDIN_FILENO);
+	  watchingInput = true;
+	}
+      }
+
+      /**
+       * @brief Receive SIGWINCH on a signalfd. The signal is blocked for
+       * this thread only, see blockResizeSignal()
+       */
+      void watchResize()
+      {
+	if (signals >= 0)
+	{
+	  return;
+	}
+	blockResizeSignal();
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGWINCH);
+	signals = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	add(signals);
+      }
+
+      void addTimer(const Clock::time_point deadline, const std::coroutine_handle<> handle)
+      {
+	const bool earliest = timers.empty() || deadline < timers.top().deadline;
+	timers.push(Timer { deadline, sequence++, handle });
+	if (earliest)
+	{
+	  arm();
+	}
+      }
+
+      /** @brief Arm the timerfd to the earliest deadline, or disarm it */
+      void arm()
+      {
+	itimerspec spec {};
+	if (!timers.empty())
+	{
+	  // Both clocks are CLOCK_MONOTONIC on Linux
+	  const auto ns =
+	      std::chrono::duration_cast<std::chrono::nanoseconds>(timers.top().deadline.time_since_epoch()).count();
+	  spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+	  spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+	  if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+	  {
+	    spec.it_value.tv_nsec = 1;
+	  }
+	}
+	timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr);
+      }
+
+      void expire()
+      {
+	const Clock::time_point now = Clock::now();
+	ready.clear();
+	while (!timers.empty() && timers.top().deadline <= now)
+	{
+	  ready.push_back(timers.top().handle);
+	  timers.pop();
+	}
+	arm();
+	resumeReady();
+      }
+
+      void notifyResize()
+      {
+	const Size size = term::size();
+	ready.clear();
+	for (ResizeAwaiter *waiter : resizeWaiters)
+	{
+	  waiter->size = size;
+	  ready.push_back(waiter->handle);
+	}
+	resizeWaiters.clear();
+	resumeReady();
+      }
+
+      void readInput()
+      {
+	char buf[256];
+	const ssize_t n = ::read(STDIN_FILENO, buf, sizeof(buf));
+	if (n <= 0)
+	{
+	  return;
+	}
+	input.append(buf, static_cast<std::size_t>(n));
+
+	std::size_t pos = 0;
+	std::vector<int> chars;
+	while (pos < input.size())
+	{
+	  const std::size_t len = termUtils::keyLength(input, pos);
+	  if (len == 0)
+	  {
+	    break;
+	  }
+	  chars.clear();
+	  for (std::size_t i = pos; i < pos + len; ++i)
+	  {
+	    // As read by getchar(), decodeKey() expects bytes as unsigned
+	    chars.push_back(static_cast<unsigned char>(input[i]));
+	  }
+	  keys.push_back(decodeKey(chars));
+	  TERM_TRACE_INPUT();
+	  pos += len;
+	}
+	input.erase(0, pos);
+
+	ready.clear();
+	while (!keys.empty() && !keyWaiters.empty())
+	{
+	  keyWaiters.front()->key = keys.front();
+	  ready.push_back(keyWaiters.front()->handle);
+	  keys.pop_front();
+	  keyWaiters.pop_front();
+	}
+	resumeReady();
+      }
+
+      /** @brief Resume the tasks collected, which may wait again meanwhile */
+      void resumeReady()
+      {
+	for (const std::coroutine_handle<> handle : ready)
+	{
+	  handle.resume();
+	}
+	ready.clear();
+      }
+  };
+
+  /** @brief Reactor of the calling thread */
+  inline Reactor& reactor()
+  {
+    static thread_local Reactor instance;
+    return instance;
+  }
+
+  /**
+   * @brief Wait for the next key without blocking the thread
+   *
+   * @return Awaitable giving the KeyEvent
+   */
+  inline Reactor::KeyAwaiter nextKey()
+  {
+    return reactor().nextKey();
+  }
+
+  /**
+   * @brief Wait for a duration without blocking the thread
+   *
+   * @param duration time to wait
+   */
+  inline Reactor::TimerAwaiter sleepFor(const std::chrono::steady_clock::duration duration)
+  {
+    return reactor().sleepFor(duration);
+  }
+
+  /**
+   * @brief Wait for the next terminal resize without blocking the thread
+   *
+   * SIGWINCH is blocked in the calling thread only. In a program with other
+   * threads, call blockResizeSignal() before starting them, or resizes may
+   * be missed.
+   *
+   * @return Awaitable giving the new Size
+   */
+  inline Reactor::ResizeAwaiter resized()
+  {
+    return reactor().resized();
+  }
+
+}
+
+#endif
+
+#endif // ASYNC_HPP
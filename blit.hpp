@@ -0,0 +1,213 @@
+#ifndef BLIT_HPP
+#define BLIT_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "cell.hpp"
+
+namespace term
+{
+
+  /** @brief Options of blitRgb() */
+  struct BlitOptions
+  {
+      /** @brief Terminal row of the top left corner, from 0 */
+      std::size_t row = 0;
+      /** @brief Terminal column of the top left corner, from 0 */
+      std::size_t col = 0;
+      /** @brief Dither to the 256 color palette instead of truecolor */
+      bool dither = false;
+  };
+
+  /**
+   * @brief Draws RGB pixels with half blocks
+   *
+   * Two pixel rows make one cell row: the upper half block takes the top
+   * pixel as foreground and the bottom one as background. Colors are only
+   * sent when they change along a row. Buffers are kept between calls.
+   */
+  class Blitter
+  {
+    public:
+      /**
+       * @brief Draw an image
+       *
+       * @param pixels RGB pixels, 3 bytes each
+       * @param width width in pixels
+       * @param height height in pixels, odd heights leave the last background
+       * @param stride bytes between two pixel rows
+       * @param options position and color mode
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       */
+      void blit(const std::uint8_t *pixels, const std::size_t width, const std::size_t height, const std::size_t stride,
+		const BlitOptions& options = BlitOptions(), std::ostream& os = std::cout, const bool flush = true)
+      {
+	out.clear();
+	top.resize(width);
+	bottom.resize(width);
+	termUtils::Emitter emitter(out);
+	emitter.style(Style());
+	fg = NONE;
+	bg = NONE;
+
+	for (std::size_t y = 0; y < height; y += 2)
+	{
+	  pack(pixels + y * stride, width, y, options.dither, top.data());
+	  const bool half = y + 1 == height;
+	  if (!half)
+	  {
+	    pack(pixels + (y + 1) * stride, width, y + 1, options.dither, bottom.data());
+	  }
+	  emitter.move(options.row + y / 2, options.col);
+
+	  for (std::size_t x = 0; x < width; ++x)
+	  {
+	    if (half)
+	    {
+	      if (bg != NONE)
+	      {
+		out += "\x1b[49m";
+		bg = NONE;
+	      }
+	      setColor(top[x], fg, false, options.dither);
+	      out += "▀";
+	    }
+	    else if (top[x] == bottom[x])
+	    {
+	      // A space only needs the background
+	      setColor(top[x], bg, true, options.dither);
+	      out += ' ';
+	    }
+	    else if (top[x] == bg && bottom[x] == fg)
+	    {
+	      // Swapped colors: the lower half block needs no change
+	      out += "▄";
+	    }
+	    else
+	    {
+	      setColor(top[x], fg, false, options.dither);
+	      setColor(bottom[x], bg, true, options.dither);
+	      out += "▀";
+	    }
+	  }
+	  emitter.invalidate();
+	}
+
+	out += color::RESET;
+	os.write(out.data(), static_cast<std::streamsize>(out.size()));
+	if (flush)
+	{
+	  os << std::flush;
+	}
+      }
+
+    private:
+      static constexpr std::uint32_t NONE = 0xFFFFFFFF;
+
+      std::string out;
+      std::vector<std::uint32_t> top;
+      std::vector<std::uint32_t> bottom;
+      std::uint32_t fg = NONE;
+      std::uint32_t bg = NONE;
+
+      /** @brief Pack a pixel row to 0xRRGGBB, or to palette indexes */
+      static void pack(const std::uint8_t *src, const std::size_t width, const std::size_t y, const bool dither,
+		       std::uint32_t *dst)
+      {
+	std::size_t x = 0;
+#ifdef __SSSE3__
+	// Four pixels per shuffle, while 16 bytes can be loaded
+	const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	for (; x + 6 <= width; x += 4)
+	{
+	  const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 3));
+	  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_shuffle_epi8(in, shuffle));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+	  dst[x] = std::uint32_t(src[x * 3]) << 16 | std::uint32_t(src[x * 3 + 1]) << 8 | src[x * 3 + 2];
+	}
+	if (dither)
+	{
+	  for (x = 0; x < width; ++x)
+	  {
+	    dst[x] = quantize(dst[x], x, y);
+	  }
+	}
+      }
+
+      /** @brief Palette index of the 6x6x6 cube with ordered dithering */
+      static std::uint32_t quantize(const std::uint32_t rgb, const std::size_t x, const std::size_t y)
+      {
+	static constexpr int BAYER[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+	// Threshold spread over one step of the cube, 51 levels
+	const int offset = (BAYER[y & 3][x & 3] * 51) / 16 - 25;
+	auto level = [offset](const int c)
+	{
+	  const int v = std::min(255, std::max(0, c + offset));
+	  return (v + 25) / 51;
+	};
+	const int r = level(static_cast<int>((rgb >> 16) & 0xFF));
+	const int g = level(static_cast<int>((rgb >> 8) & 0xFF));
+	const int b = level(static_cast<int>(rgb & 0xFF));
+	return static_cast<std::uint32_t>(16 + 36 * r + 6 * g + b);
+      }
+
+      /** @brief Send a color if it differs from the current one */
+      void setColor(const std::uint32_t value, std::uint32_t& current, const bool background, const bool dither)
+      {
+	if (value == current)
+	{
+	  return;
+	}
+	current = value;
+	out += background ? "\x1b[48;" : "\x1b[38;";
+	if (dither)
+	{
+	  out += "5;";
+	  termUtils::appendNumber(out, value);
+	}
+	else
+	{
+	  out += "2;";
+	  termUtils::appendNumber(out, (value >> 16) & 0xFF);
+	  out += ';';
+	  termUtils::appendNumber(out, (value >> 8) & 0xFF);
+	  out += ';';
+	  termUtils::appendNumber(out, value & 0xFF);
+	}
+	out += 'm';
+      }
+  };
+
+  /**
+   * @brief Draw RGB pixels with half blocks, two pixel rows per cell row
+   *
+   * @param pixels RGB pixels, 3 bytes each
+   * @param width width in pixels
+   * @param height height in pixels
+   * @param stride bytes between two pixel rows
+   * @param options position and color mode
+   * @param os output. Default is std::cout
+   * @param flush true if flushes the output immediately. Default is true
+   */
+  inline void blitRgb(const std::uint8_t *pixels, const std::size_t width, const std::size_t height,
+		      const std::size_t stride, const BlitOptions& options = BlitOptions(), std::ostream& os = std::cout,
+		      const bool flush = true)
+  {
+    static thread_local Blitter blitter;
+    blitter.blit(pixels, width, height, stride, options, os, flush);
+  }
+
+}
+
+#endif // BLIT_HPP
@@ -0,0 +1,339 @@
+#ifndef CAPABILITIES_HPP
+#define CAPABILITIES_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace term
+{
+
+  /**
+   * @brief Sequences and features of the terminal in use
+   *
+   * Defaults describe xterm, which the library assumed so far. Empty strings
+   * mean the terminal does not support the capability. Parameterized strings
+   * use the terminfo syntax, see termUtils::tparm().
+   */
+  struct Capabilities
+  {
+      /** @brief Name of the terminal description, from $TERM */
+      std::string name = "xterm";
+
+      /** @brief Reset modes and attributes, keeping the screen contents (rs2 unless it is a full reset) */
+      std::string softReset = "\x1b[!p";
+      /** @brief Clear screen and home cursor (clear) */
+      std::string clearScreen = "\x1b[H\x1b[2J";
+      /** @brief Clear to end of line (el) */
+      std::string clearEol = "\x1b[K";
+      /** @brief Clear to beginning of line (el1) */
+      std::string clearBol = "\x1b[1K";
+      /** @brief Clear to end of screen (ed) */
+      std::string clearEos = "\x1b[J";
+      /** @brief Move cursor to row, col (cup) */
+      std::string cursorAddress = "\x1b[%i%p1%d;%p2%dH";
+      /** @brief Move cursor to col (hpa) */
+      std::string columnAddress = "\x1b[%i%p1%dG";
+      /** @brief Move cursor right by n (cuf) */
+      std::string cursorRight = "\x1b[%p1%dC";
+      /** @brief Move cursor left by n (cub) */
+      std::string cursorLeft = "\x1b[%p1%dD";
+      /** @brief Hide cursor (civis) */
+      std::string cursorInvisible = "\x1b[?25l";
+      /** @brief Show cursor (cnorm) */
+      std::string cursorNormal = "\x1b[?25h";
+      /** @brief Save cursor position (sc) */
+      std::string saveCursor = "\x1b" "7";
+      /** @brief Restore cursor position (rc) */
+      std::string restoreCursor = "\x1b" "8";
+      /** @brief Enter alternate screen (smcup) */
+      std::string enterCaMode = "\x1b[?1049h\x1b[?47h";
+      /** @brief Exit alternate screen (rmcup) */
+      std::string exitCaMode = "\x1b[?47l\x1b[?1049l";
+      /** @brief Set scroll region from row to row (csr) */
+      std::string scrollRegion = "\x1b[%i%p1%d;%p2%dr";
+      /** @brief Erase n characters (ech) */
+      std::string eraseChars = "\x1b[%p1%dX";
+      /** @brief Repeat a character n times (rep) */
+      std::string repeatChar;
+      /** @brief Turn off all attributes (sgr0) */
+      std::string exitAttributes = "\x1b[0m";
+
+      /** @brief Number of colors */
+      int colors = 8;
+      /** @brief 24 bit colors (RGB or Tc extended capabilities) */
+      bool trueColor = false;
+      /** @brief Clearing uses the current background color (bce) */
+      bool backColorErase = false;
+      /** @brief Cursor wraps at the right margin (am) */
+      bool autoMargin = true;
+
+      // Features reported by the terminal itself, see probeTerminal()
+
+      /** @brief True once the terminal answered a probe */
+      bool probed = false;
+      /** @brief Conformance level and features from primary device attributes */
+      std::vector<int> deviceAttributes;
+      /** @brief Terminal type from secondary device attributes */
+      int terminalType = -1;
+      /** @brief Firmware version from secondary device attributes */
+      int firmwareVersion = -1;
+      /** @brief Name and version reported by XTVERSION */
+      std::string version;
+      /** @brief Synchronized output, mode 2026 */
+      bool synchronizedOutput = false;
+      /** @brief Bracketed paste, mode 2004 */
+      bool bracketedPaste = false;
+      /** @brief SGR mouse reports, mode 1006 */
+      bool sgrMouse = false;
+      /** @brief Default foreground as 0xRRGGBB, -1 if unknown */
+      long foreground = -1;
+      /** @brief Default background as 0xRRGGBB, -1 if unknown */
+      long background = -1;
+  };
+
+  /** @brief Capabilities used by the library */
+  inline Capabilities& capabilitiesStorage()
+  {
+    static Capabilities caps;
+    return caps;
+  }
+
+  /**
+   * @brief Capabilities of the terminal in use
+   * @return The profile set by setCapabilities(), xterm by default
+   */
+  inline const Capabilities& capabilities()
+  {
+    return capabilitiesStorage();
+  }
+
+  /**
+   * @brief Change the capabilities used by the library
+   *
+   * Not thread safe: call at startup, before output starts.
+   */
+  inline void setCapabilities(const Capabilities& caps)
+  {
+    capabilitiesStorage() = caps;
+  }
+
+}
+
+namespace termUtils
+{
+
+/**
+ * @brief Capability string, or a fallback if the terminal lacks it
+ */
+inline std::string_view sequence(const std::string& cap, std::string_view fallback)
+{
+    return cap.empty() ? fallback : std::string_view(cap);
+}
+
+/**
+ * @brief Append a parameterized terminfo string
+ *
+ * Supports the terminfo stack language: %p, %d, %c, %s (as number), %i,
+ * %{n}, %'c', %P/%g variables, arithmetic, logic and %? %t %e %; conditions.
+ *
+ * @param out output
+ * @param cap capability string
+ * @param p1, p2 first two parameters
+ */
+inline void tparm(std::string& out, std::string_view cap, int p1 = 0, int p2 = 0)
+{
+    int params[9] = { p1, p2, 0, 0, 0, 0, 0, 0, 0 };
+    int stack[16];
+    int sp = 0;
+    int vars[52] = { 0 };
+
+    auto push = [&](const int v) {
+        if(sp < 16) {
+            stack[sp++] = v;
+        }
+    };
+    auto pop = [&]() {
+        return sp > 0 ? stack[--sp] : 0;
+    };
+    // Skip to the matching %e or %; of the current condition level
+    auto skip = [&](std::size_t& i, const bool toElse) {
+        int level = 0;
+        while(i + 1 < cap.size()) {
+            if(cap[i] == '%') {
+                const char c = cap[i + 1];
+                i += 2;
+                if(c == '?') {
+                    ++level;
+                } else if(c == ';') {
+                    if(level == 0) {
+                        return;
+                    }
+                    --level;
+                } else if(c == 'e' && level == 0 && toElse) {
+                    return;
+                }
+            } else {
+                ++i;
+            }
+        }
+        i = cap.size();
+    };
+
+    std::size_t i = 0;
+    while(i < cap.size()) {
+        const char c = cap[i++];
+        if(c != '%' || i >= cap.size()) {
+            out += c;
+            continue;
+        }
+
+        // Optional printf like flags, width and precision. Flags - and + need
+        // a leading colon to be told from the operators
+        bool zero = false;
+        int width = 0;
+        if(cap[i] == ':') {
+            ++i;
+            while(i < cap.size() && (cap[i] == '-' || cap[i] == '+' || cap[i] == ' ' || cap[i] == '#')) {
+                ++i;
+            }
+        }
+        if(i < cap.size() && cap[i] == '0') {
+            zero = true;
+            ++i;
+        }
+        while(i < cap.size() && cap[i] >= '0' && cap[i] <= '9') {
+            width = width * 10 + (cap[i++] - '0');
+        }
+        if(i < cap.size() && cap[i] == '.') {
+            ++i;
+            while(i < cap.size() && cap[i] >= '0' && cap[i] <= '9') {
+                ++i;
+            }
+        }
+        if(i >= cap.size()) {
+            break;
+        }
+
+        const char op = cap[i++];
+        switch(op) {
+        case '%':
+            out += '%';
+            break;
+        case 'd':
+        case 's':
+        case 'x':
+        case 'X':
+        case 'o': {
+            const int v = pop();
+            char buf[16];
+            const auto res = std::to_chars(buf, buf + sizeof(buf), v, op == 'd' || op == 's' ? 10 : op == 'o' ? 8 : 16);
+            const int len = static_cast<int>(res.ptr - buf);
+            if(len < width) {
+                out.append(static_cast<std::size_t>(width - len), zero ? '0' : ' ');
+            }
+            out.append(buf, res.ptr);
+            break;
+        }
+        case 'c':
+            out += static_cast<char>(pop());
+            break;
+        case 'p':
+            if(i < cap.size() && cap[i] >= '1' && cap[i] <= '9') {
+                push(params[cap[i++] - '1']);
+            }
+            break;
+        case 'P':
+            if(i < cap.size()) {
+                const char v = cap[i++];
+                if(v >= 'a' && v <= 'z') {
+                    vars[v - 'a'] = pop();
+                } else if(v >= 'A' && v <= 'Z') {
+                    vars[26 + v - 'A'] = pop();
+                }
+            }
+            break;
+        case 'g':
+            if(i < cap.size()) {
+                const char v = cap[i++];
+                if(v >= 'a' && v <= 'z') {
+                    push(vars[v - 'a']);
+                } else if(v >= 'A' && v <= 'Z') {
+                    push(vars[26 + v - 'A']);
+                }
+            }
+            break;
+        case '\'':
+            if(i + 1 < cap.size()) {
+                push(static_cast<unsigned char>(cap[i]));
+                i += 2;
+            }
+            break;
+        case '{': {
+            int v = 0;
+            while(i < cap.size() && cap[i] >= '0' && cap[i] <= '9') {
+                v = v * 10 + (cap[i++] - '0');
+            }
+            if(i < cap.size()) {
+                ++i;
+            }
+            push(v);
+            break;
+        }
+        case 'l':
+            pop();
+            push(0);
+            break;
+        case 'i':
+            ++params[0];
+            ++params[1];
+            break;
+        case '+': case '-': case '*': case '/': case 'm':
+        case '&': case '|': case '^': case '=': case '>': case '<': case 'A': case 'O': {
+            const int b = pop();
+            const int a = pop();
+            switch(op) {
+            case '+': push(a + b); break;
+            case '-': push(a - b); break;
+            case '*': push(a * b); break;
+            case '/': push(b != 0 ? a / b : 0); break;
+            case 'm': push(b != 0 ? a % b : 0); break;
+            case '&': push(a & b); break;
+            case '|': push(a | b); break;
+            case '^': push(a ^ b); break;
+            case '=': push(a == b); break;
+            case '>': push(a > b); break;
+            case '<': push(a < b); break;
+            case 'A': push(a && b); break;
+            case 'O': push(a || b); break;
+            }
+            break;
+        }
+        case '!':
+            push(!pop());
+            break;
+        case '~':
+            push(~pop());
+            break;
+        case '?':
+            break;
+        case 't':
+            if(!pop()) {
+                skip(i, true);
+            }
+            break;
+        case 'e':
+            // End of a taken branch: skip the else part
+            skip(i, false);
+            break;
+        case ';':
+            break;
+        }
+    }
+}
+
+};
+
+#endif // CAPABILITIES_HPP
@@ -0,0 +1,747 @@
+#ifndef CELL_HPP
+#define CELL_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "term.hpp"
+
+namespace term
+{
+
+  namespace color
+  {
+    /** @brief Terminal default color */
+    inline constexpr std::uint32_t DEFAULT = 0;
+
+    /**
+     * @brief Cell color from one of the 256 indexed colors
+     *
+     * @param color A short between 0 and 255
+     */
+    constexpr std::uint32_t indexed(const unsigned char color)
+    {
+      return 0x01000000u | color;
+    }
+
+    /**
+     * @brief Cell color from RGB components
+     *
+     * @param r, g, b A short between 0 and 255
+     */
+    constexpr std::uint32_t rgb(const unsigned char r, const unsigned char g, const unsigned char b)
+    {
+      return 0x02000000u | (std::uint32_t(r) << 16) | (std::uint32_t(g) << 8) | b;
+    }
+  }
+
+  namespace attr
+  {
+    /** @brief No attribute */
+    inline constexpr std::uint32_t NONE = 0;
+    /** @brief Bright attribute */
+    inline constexpr std::uint32_t BRIGHT = 1;
+    /** @brief Dim attribute */
+    inline constexpr std::uint32_t DIM = 2;
+    /** @brief Underscore attribute */
+    inline constexpr std::uint32_t UNDERSCORE = 4;
+    /** @brief Blink attribute */
+    inline constexpr std::uint32_t BLINK = 8;
+    /** @brief Reverse attribute */
+    inline constexpr std::uint32_t REVERSE = 16;
+  }
+
+  /** @brief Colors and attributes of a cell */
+  struct Style
+  {
+      std::uint32_t fg = color::DEFAULT;
+      std::uint32_t bg = color::DEFAULT;
+      std::uint32_t attrs = attr::NONE;
+
+      bool operator ==(const Style&) const = default;
+  };
+
+  /** @brief One character cell of the screen */
+  struct Cell
+  {
+      char32_t ch = U' ';
+      Style style;
+
+      bool operator ==(const Cell&) const = default;
+  };
+
+  /** @brief Rectangle of cells, 0 based */
+  struct Rect
+  {
+      std::size_t row = 0;
+      std::size_t col = 0;
+      std::size_t rows = 0;
+      std::size_t cols = 0;
+
+      bool empty() const
+      {
+	return rows == 0 || cols == 0;
+      }
+
+      bool contains(const std::size_t r, const std::size_t c) const
+      {
+	return r >= row && r < row + rows && c >= col && c < col + cols;
+      }
+
+      /** @brief Intersection with another rectangle */
+      Rect intersect(const Rect& rc) const
+      {
+	const std::size_t top = std::max(row, rc.row);
+	const std::size_t left = std::max(col, rc.col);
+	const std::size_t bottom = std::min(row + rows, rc.row + rc.rows);
+	const std::size_t right = std::min(col + cols, rc.col + rc.cols);
+	if (bottom <= top || right <= left)
+	{
+	  return Rect();
+	}
+	return Rect { top, left, bottom - top, right - left };
+      }
+
+      bool operator ==(const Rect&) const = default;
+  };
+
+  /** @brief Off-screen grid of cells */
+  class CellBuffer
+  {
+    public:
+      CellBuffer()
+      {
+      }
+
+      CellBuffer(const Size& size, const Cell& fill = Cell())
+      {
+	resize(size, fill);
+      }
+
+      /**
+       * @brief Resize the buffer. Content is lost
+       *
+       * @param size new size
+       * @param fill cell used for the whole buffer
+       */
+      void resize(const Size& size, const Cell& fill = Cell())
+      {
+	sz = size;
+	cells.assign(size.rows * size.cols, fill);
+      }
+
+      const Size& size() const
+      {
+	return sz;
+      }
+
+      std::size_t rows() const
+      {
+	return sz.rows;
+      }
+
+      std::size_t cols() const
+      {
+	return sz.cols;
+      }
+
+      Cell* row(const std::size_t r)
+      {
+	return cells.data() + r * sz.cols;
+      }
+
+      const Cell* row(const std::size_t r) const
+      {
+	return cells.data() + r * sz.cols;
+      }
+
+      Cell& at(const std::size_t r, const std::size_t c)
+      {
+	return cells[r * sz.cols + c];
+      }
+
+      const Cell& at(const std::size_t r, const std::size_t c) const
+      {
+	return cells[r * sz.cols + c];
+      }
+
+      /** @brief Fill the whole buffer */
+      void fill(const Cell& cell = Cell())
+      {
+	std::fill(cells.begin(), cells.end(), cell);
+      }
+
+      /** @brief Fill a rectangle, clipped to the buffer */
+      void fill(const Rect& rect, const Cell& cell = Cell())
+      {
+	const Rect rc = rect.intersect(Rect { 0, 0, sz.rows, sz.cols });
+	for (std::size_t r = rc.row; r < rc.row + rc.rows; ++r)
+	{
+	  std::fill_n(row(r) + rc.col, rc.cols, cell);
+	}
+      }
+
+      /**
+       * @brief Write UTF-8 text on a row, clipped to the buffer
+       *
+       * @param r row
+       * @param c first column
+       * @param text UTF-8 text
+       * @param style style of the cells
+       * @return Column after the last written cell
+       */
+      std::size_t print(const std::size_t r, std::size_t c, std::string_view text, const Style& style =
+			    Style());
+
+      /**
+       * @brief Copy a rectangle of another buffer, clipped to both buffers
+       *
+       * @param src source buffer
+       * @param from rectangle in the source buffer
+       * @param r, c destination of the top left corner
+       */
+      void blit(const CellBuffer& src, const Rect& from, const std::size_t r, const std::size_t c)
+      {
+	Rect rc = from.intersect(Rect { 0, 0, src.rows(), src.cols() });
+	const std::size_t rows = std::min(rc.rows, sz.rows > r ? sz.rows - r : 0);
+	const std::size_t cols = std::min(rc.cols, sz.cols > c ? sz.cols - c : 0);
+	for (std::size_t i = 0; i < rows; ++i)
+	{
+	  std::copy_n(src.row(rc.row + i) + rc.col, cols, row(r + i) + c);
+	}
+      }
+
+    private:
+      Size sz;
+      std::vector<Cell> cells;
+  };
+
+}
+
+namespace termUtils
+{
+
+/** @brief Unicode replacement character */
+static constexpr char32_t REPLACEMENT = 0xFFFD;
+
+/**
+ * @brief Decode one UTF-8 code point
+ *
+ * @param text UTF-8 text
+ * @param i index of the first byte, moved after the sequence
+ * @return Code point, REPLACEMENT on invalid sequence
+ */
+inline char32_t decodeUtf8(std::string_view text, std::size_t& i)
+{
+    const unsigned char c = static_cast<unsigned char>(text[i++]);
+    if(c < 0x80) {
+        return c;
+    }
+
+    std::size_t len = 0;
+    char32_t cp = 0;
+    char32_t min = 0;
+    if((c & 0xE0) == 0xC0) {
+        len = 1;
+        cp = c & 0x1F;
+        min = 0x80;
+    } else if((c & 0xF0) == 0xE0) {
+        len = 2;
+        cp = c & 0x0F;
+        min = 0x800;
+    } else if((c & 0xF8) == 0xF0) {
+        len = 3;
+        cp = c & 0x07;
+        min = 0x10000;
+    } else {
+        return REPLACEMENT;
+    }
+
+    for(std::size_t n = 0; n < len; ++n) {
+        if(i >= text.size() || (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) {
+            return REPLACEMENT;
+        }
+        cp = (cp << 6) | (static_cast<unsigned char>(text[i++]) & 0x3F);
+    }
+    if(cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return REPLACEMENT;
+    }
+    return cp;
+}
+
+/** @brief Append a code point encoded in UTF-8 */
+inline void appendUtf8(std::string& out, const char32_t cp)
+{
+    if(cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if(cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if(cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+/** @brief Append a decimal number without allocation */
+inline void appendNumber(std::string& out, const std::size_t value)
+{
+    char buf[20];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr);
+}
+
+/**
+ * @brief Column of the first cell differing between two rows
+ *
+ * Cells are compared as bytes, 4 at a time with AVX2 or SSE2 when the
+ * compiler targets them, so long unchanged spans are skipped quickly.
+ *
+ * @param a, b rows to compare
+ * @param from first column compared
+ * @param to column after the last one compared
+ * @return Column of the first difference, to if the cells are equal
+ */
+inline std::size_t findDifference(const term::Cell* a, const term::Cell* b, std::size_t from, const std::size_t to)
+{
+    static_assert(sizeof(term::Cell) == 16 && std::has_unique_object_representations_v<term::Cell>,
+                  "cells are compared as 16 bytes");
+#if defined(__AVX2__)
+    // Two cells per vector
+    while(from + 4 <= to) {
+        const __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + from));
+        const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + from));
+        const __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + from + 2));
+        const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + from + 2));
+        const __m256i same = _mm256_and_si256(_mm256_cmpeq_epi32(a0, b0), _mm256_cmpeq_epi32(a1, b1));
+        if(_mm256_movemask_epi8(same) != -1) {
+            break;
+        }
+        from += 4;
+    }
+#elif defined(__SSE2__)
+    // One cell per vector
+    while(from + 4 <= to) {
+        const __m128i* va = reinterpret_cast<const __m128i*>(a + from);
+        const __m128i* vb = reinterpret_cast<const __m128i*>(b + from);
+        const __m128i same01 = _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128(va), _mm_loadu_si128(vb)),
+                                             _mm_cmpeq_epi32(_mm_loadu_si128(va + 1), _mm_loadu_si128(vb + 1)));
+        const __m128i same23 = _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128(va + 2), _mm_loadu_si128(vb + 2)),
+                                             _mm_cmpeq_epi32(_mm_loadu_si128(va + 3), _mm_loadu_si128(vb + 3)));
+        if(_mm_movemask_epi8(_mm_and_si128(same01, same23)) != 0xFFFF) {
+            break;
+        }
+        from += 4;
+    }
+#endif
+    while(from < to && a[from] == b[from]) {
+        ++from;
+    }
+    return from;
+}
+
+/**
+ * @brief Builds the escape sequences drawing cells
+ *
+ * Tracks the cursor position and the current SGR state so that moves and
+ * style changes are only emitted when needed. Positions are 0 based.
+ */
+class Emitter
+{
+public:
+    static constexpr std::size_t UNKNOWN = static_cast<std::size_t>(-1);
+
+    /**
+     * @brief Emitter appending to a buffer
+     *
+     * @param out output buffer
+     * @param caps terminal the bytes are for, outliving the emitter
+     */
+    explicit Emitter(std::string& out, const term::Capabilities& caps = term::capabilities())
+        : out(out), caps(caps)
+    {
+    }
+
+    /** @brief Forget cursor and style, e.g. after external output */
+    void invalidate()
+    {
+        row = UNKNOWN;
+        col = UNKNOWN;
+        styleKnown = false;
+    }
+
+    /** @brief Move the cursor */
+    void move(const std::size_t r, const std::size_t c)
+    {
+        if(r == row && c == col) {
+            return;
+        }
+        if(r == row && col != UNKNOWN && c > col && c - col < 4) {
+            // CUF is cheaper than CUP on the same row
+            out += "\x1b[";
+            if(c - col > 1) {
+                appendNumber(out, c - col);
+            }
+            out += 'C';
+        } else if(r == 0 && c == 0) {
+            out += "\x1b[H";
+        } else {
+            out += "\x1b[";
+            appendNumber(out, r + 1);
+            if(c != 0) {
+                out += ';';
+                appendNumber(out, c + 1);
+            }
+            out += 'H';
+        }
+        row = r;
+        col = c;
+    }
+
+    /** @brief Switch to a style with the shortest SGR sequence */
+    void style(const term::Style& st)
+    {
+        if(styleKnown && st == current) {
+            return;
+        }
+        out += "\x1b[";
+        if(!styleKnown || (current.attrs & ~st.attrs) != 0) {
+            // Attributes can only be removed by a reset
+            out += '0';
+            appendAttrs(st.attrs);
+            if(st.fg != term::color::DEFAULT) {
+                appendColor(st.fg, false);
+            }
+            if(st.bg != term::color::DEFAULT) {
+                appendColor(st.bg, true);
+            }
+        } else {
+            bool first = true;
+            const std::uint32_t added = st.attrs & ~current.attrs;
+            if(added != 0) {
+                appendAttrs(added);
+                first = false;
+            }
+            if(st.fg != current.fg) {
+                appendColor(st.fg, false, first);
+                first = false;
+            }
+            if(st.bg != current.bg) {
+                appendColor(st.bg, true, first);
+            }
+        }
+        out += 'm';
+        current = st;
+        styleKnown = true;
+    }
+
+    /** @brief Draw a cell at the cursor position */
+    void put(const term::Cell& cell)
+    {
+        style(cell.style);
+        appendUtf8(out, cell.ch);
+        if(col != UNKNOWN) {
+            ++col;
+        }
+    }
+
+    /**
+     * @brief Draw cells of a row
+     *
+     * @param cells first cell to draw
+     * @param r, c position of the first cell
+     * @param count number of cells
+     * @param width width of the screen, to track the pending wrap
+     */
+    void cells(const term::Cell* cells, const std::size_t r, const std::size_t c, const std::size_t count,
+               const std::size_t width)
+    {
+        if(count == 0) {
+            return;
+        }
+        move(r, c);
+        std::size_t i = 0;
+        while(i < count) {
+            std::size_t n = 1;
+            while(i + n < count && cells[i + n] == cells[i]) {
+                ++n;
+            }
+            if(n < MIN_RUN || !repeat(cells[i], n, c + i + n >= width)) {
+                for(std::size_t k = 0; k < n; ++k) {
+                    put(cells[i + k]);
+                }
+            }
+            i += n;
+        }
+        if(c + count >= width) {
+            // The cursor is left in the pending wrap state
+            col = UNKNOWN;
+        }
+    }
+
+    /**
+     * @brief Draw the cells of a rectangle which differ between two buffers
+     *
+     * Close changed spans of a row are merged when rewriting the unchanged
+     * cells between them is cheaper than moving the cursor.
+     *
+     * @param front cells currently on the terminal
+     * @param back cells to display, same size as front
+     * @param rect area to compare
+     */
+    void diff(const term::CellBuffer& front, const term::CellBuffer& back, const term::Rect& rect)
+    {
+        const term::Rect rc = rect.intersect(term::Rect { 0, 0, back.rows(), back.cols() });
+        for(std::size_t r = rc.row; r < rc.row + rc.rows; ++r) {
+            diffRow(front, back, r, rc.col, rc.col + rc.cols);
+        }
+    }
+
+    /**
+     * @brief Draw the cells of a row which differ between two buffers, see
+     * diff()
+     *
+     * @param front cells currently on the terminal
+     * @param back cells to display, same size as front
+     * @param r row, inside the buffers
+     * @param from first column compared
+     * @param right column after the last one compared, at most the width
+     */
+    void diffRow(const term::CellBuffer& front, const term::CellBuffer& back, const std::size_t r, const std::size_t from,
+                 const std::size_t right)
+    {
+        const term::Cell* a = front.row(r);
+        const term::Cell* b = back.row(r);
+        std::size_t c = from;
+        while(c < right) {
+            c = findDifference(a, b, c, right);
+            if(c == right) {
+                break;
+            }
+            std::size_t end = c + 1;
+            std::size_t same = 0;
+            while(end + same < right && same <= MERGE_GAP) {
+                if(a[end + same] == b[end + same]) {
+                    ++same;
+                } else {
+                    end += same + 1;
+                    same = 0;
+                }
+            }
+            cells(b + c, r, c, end - c, back.cols());
+            c = end;
+        }
+    }
+
+    /**
+     * @brief Draw all the cells of a rectangle
+     *
+     * Blank rows down to the bottom of the screen are erased at once when the
+     * rectangle spans the whole width.
+     */
+    void full(const term::CellBuffer& back, const term::Rect& rect)
+    {
+        const term::Rect rc = rect.intersect(term::Rect { 0, 0, back.rows(), back.cols() });
+        std::size_t bottom = rc.row + rc.rows;
+        const std::string& clearEos = caps.clearEos;
+        if(rc.col == 0 && rc.cols == back.cols() && bottom == back.rows() && rc.rows > 0 && !clearEos.empty()
+           && erasable(back.at(bottom - 1, 0))) {
+            const term::Cell blank = back.at(bottom - 1, 0);
+            while(bottom > rc.row) {
+                const term::Cell* row = back.row(bottom - 1);
+                if(!std::all_of(row, row + rc.cols, [&blank](const term::Cell& cell) { return cell == blank; })) {
+                    break;
+                }
+                --bottom;
+            }
+            if(bottom < rc.row + rc.rows) {
+                move(bottom, 0);
+                style(blank.style);
+                out += clearEos;
+            }
+        }
+        for(std::size_t r = rc.row; r < bottom; ++r) {
+            cells(back.row(r) + rc.col, r, rc.col, rc.cols, back.cols());
+        }
+    }
+
+    /**
+     * @brief Append bytes drawing cells, rendered from an unknown style
+     *
+     * @param bytes escape sequences and text of the cells
+     * @param last style of the last cell
+     * @param count number of cells drawn
+     * @param width width of the screen, to track the pending wrap
+     */
+    void raw(std::string_view bytes, const term::Style& last, const std::size_t count, const std::size_t width)
+    {
+        out += bytes;
+        if(count == 0) {
+            return;
+        }
+        current = last;
+        styleKnown = true;
+        if(col != UNKNOWN) {
+            col += count;
+            if(col >= width) {
+                col = UNKNOWN;
+            }
+        }
+    }
+
+    /** @brief Reset the style to the terminal default */
+    void reset()
+    {
+        if(!styleKnown || current != term::Style()) {
+            out += "\x1b[0m";
+            current = term::Style();
+            styleKnown = true;
+        }
+    }
+
+private:
+    /** @brief Unchanged cells rewritten rather than skipped by a move */
+    static constexpr std::size_t MERGE_GAP = 4;
+    /** @brief Shortest run of equal cells worth compressing */
+    static constexpr std::size_t MIN_RUN = 4;
+
+    std::string& out;
+    const term::Capabilities& caps;
+    std::size_t row = UNKNOWN;
+    std::size_t col = UNKNOWN;
+    term::Style current;
+    bool styleKnown = false;
+
+    /** @brief True if erasing gives the same cell: a blank with the erase background */
+    bool erasable(const term::Cell& cell) const
+    {
+        return cell.ch == U' ' && (cell.style.attrs & (term::attr::UNDERSCORE | term::attr::REVERSE)) == 0
+               && (cell.style.bg == term::color::DEFAULT || caps.backColorErase);
+    }
+
+    /**
+     * @brief Draw a run of equal cells with REP, ECH or EL
+     *
+     * @param cell cell repeated
+     * @param n length of the run
+     * @param toEnd true if the run ends at the right margin
+     * @return False if the terminal lacks the sequences or they are not
+     * shorter than the cells, nothing is then written
+     */
+    bool repeat(const term::Cell& cell, const std::size_t n, const bool toEnd)
+    {
+        const std::size_t plain = n * (cell.ch < 0x80 ? 1 : cell.ch < 0x800 ? 2 : cell.ch < 0x10000 ? 3 : 4);
+        const std::size_t start = out.size();
+        const term::Style previous = current;
+        const bool known = styleKnown;
+        style(cell.style);
+        const std::size_t body = out.size();
+
+        if(erasable(cell) && toEnd && !caps.clearEol.empty()) {
+            out += caps.clearEol;
+        } else if(erasable(cell) && !toEnd && !caps.eraseChars.empty()) {
+            // ECH leaves the cursor in place
+            tparm(out, caps.eraseChars, static_cast<int>(n));
+            tparm(out, sequence(caps.cursorRight, "\x1b[%p1%dC"), static_cast<int>(n));
+        } else if(cell.ch < 0x80 && !caps.repeatChar.empty()) {
+            tparm(out, caps.repeatChar, static_cast<int>(cell.ch), static_cast<int>(n));
+        }
+
+        if(out.size() == body || out.size() - body >= plain) {
+            out.resize(start);
+            current = previous;
+            styleKnown = known;
+            return false;
+        }
+        if(col != UNKNOWN) {
+            col += n;
+        }
+        return true;
+    }
+
+    void appendAttrs(const std::uint32_t attrs)
+    {
+        static constexpr std::string_view CODES[] = { "1", "2", "4", "5", "7" };
+        bool first = out.back() == '[';
+        for(std::size_t i = 0; i < 5; ++i) {
+            if(attrs & (1u << i)) {
+                if(!first) {
+                    out += ';';
+                }
+                out += CODES[i];
+                first = false;
+            }
+        }
+    }
+
+    void appendColor(const std::uint32_t color, const bool background, const bool first = false)
+    {
+        if(!first) {
+            out += ';';
+        }
+        const std::size_t base = background ? 40 : 30;
+        const std::uint32_t kind = color >> 24;
+        if(kind == 0) {
+            appendNumber(out, base + 9);
+        } else if(kind == 1) {
+            const std::size_t index = color & 0xFF;
+            if(index < 8) {
+                appendNumber(out, base + index);
+            } else if(index < 16) {
+                appendNumber(out, base + 60 + index - 8);
+            } else {
+                appendNumber(out, base + 8);
+                out += ";5;";
+                appendNumber(out, index);
+            }
+        } else {
+            appendNumber(out, base + 8);
+            out += ";2;";
+            appendNumber(out, (color >> 16) & 0xFF);
+            out += ';';
+            appendNumber(out, (color >> 8) & 0xFF);
+            out += ';';
+            appendNumber(out, color & 0xFF);
+        }
+    }
+};
+
+};
+
+namespace term
+{
+
+  inline std::size_t CellBuffer::print(const std::size_t r, std::size_t c, std::string_view text, const Style& style)
+  {
+    if (r >= sz.rows)
+    {
+      return c;
+    }
+    std::size_t i = 0;
+    while (i < text.size() && c < sz.cols)
+    {
+      at(r, c++) = Cell { termUtils::decodeUtf8(text, i), style };
+    }
+    return c;
+  }
+
+}
+
+#endif // CELL_HPP
@@ -0,0 +1,323 @@
+#ifndef CONSOLE_HPP
+#define CONSOLE_HPP
+
+/*
+ * Definitions of the console functions declared in term.hpp. Included by
+ * term.hpp, or compiled once in the term library when TERM_COMPILED is
+ * defined.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <span>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include <conio.h>
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#endif
+
+#include "term.hpp"
+#include "trace.hpp"
+
+namespace termUtils
+{
+#ifdef _WIN32
+//static constexpr unsigned char ENABLE_VIRTUAL_TERMINAL_PROCESSING = 0x0004;
+TERM_DECL HANDLE stdoutHandle;
+TERM_DECL HANDLE stdinHandle;
+TERM_DECL DWORD outModeInit;
+TERM_DECL DWORD inModeInit;
+TERM_DECL CONSOLE_FONT_INFOEX cfiOld = { sizeof(CONSOLE_FONT_INFOEX) };
+#endif
+
+#ifdef __linux__
+static constexpr tcflag_t TERM_FLAGS = ICANON | ECHO | ISIG | IEXTEN | ICRNL | IXON | IUTF8;
+TERM_DECL termios savedTerm;
+static constexpr int STDIN = 0;
+TERM_DECL bool initialized = false;
+#endif
+
+/**
+ * @brief Get key pressed
+ * @return bool if a key was pressed or noti
+ */
+TERM_DECL int kbHit()
+{
+#ifdef _WIN32
+    return _kbhit();
+#endif
+
+#ifdef __linux__
+    if(!initialized) {
+        // Use termios to turn off line buffering
+        termios term;
+        tcgetattr(STDIN, &term);
+        term.c_lflag &= ~ICANON;
+        tcsetattr(STDIN, TCSANOW, &term);
+        setbuf(stdin, NULL);
+        initialized = true;
+    }
+
+    int bytesWaiting;
+    ioctl(STDIN, FIONREAD, &bytesWaiting);
+    return bytesWaiting;
+#endif
+}
+
+};
+
+namespace term
+{
+
+  TERM_DECL std::ostream& defaultOutput()
+  {
+    return std::cout;
+  }
+
+  TERM_DECL Size size()
+  {
+    std::size_t r = 0;
+    std::size_t c = 0;
+
+#ifdef __linux__
+    winsize w;
+    ioctl(fileno(stdout), TIOCGWINSZ, &w);
+    r = w.ws_row;
+    c = w.ws_col;
+#endif
+
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO sbInfo;
+    GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &sbInfo);
+    c = sbInfo.dwSize.X;
+    r = sbInfo.srWindow.Right - sbInfo.srWindow.Left + 1;
+#endif
+    return Size(r, c);
+  }
+
+  TERM_DECL bool isKeyPressed()
+  {
+    return termUtils::kbHit() > 0;
+  }
+
+  TERM_DECL KeyEvent keyPress()
+  {
+    int chr = 0;
+    int hit = termUtils::kbHit();
+    // Longer sequences are cut, the bytes left are read next time
+    int chars[32];
+    std::size_t count = 0;
+
+    while (hit > 0 && count < std::size(chars) - 1)
+    {
+#ifdef _WIN32
+
+      chr = _getch();
+
+      switch (chr)
+      {
+	case '\x09':  // TAB
+	  return KeyEvent(Key::Tab, 9);
+	case '\x0a':  // LF; falls-through
+	case '\x0d':  // CR
+	  return KeyEvent(Key::Enter, 13);
+	case '\x7f':  // DEL
+	  return KeyEvent(Key::Backspace, 8);
+      }
+
+      chars[count++] = chr;
+      if (chr == 0 || chr == 224)
+      {
+	chr = _getch();
+	chars[count++] = chr;
+      }
+
+#endif
+#ifdef __linux__
+        chr = std::getchar();
+        chars[count++] = chr;
+        if (count == 1 && chr != 27)
+        {
+          // One character per key press, the bytes left are read next time
+          hit = std::min(hit, static_cast<int>(termUtils::utf8Length(static_cast<unsigned char>(chr))));
+        }
+#endif
+
+      hit--;
+    }
+
+    if (count > 0)
+    {
+      TERM_TRACE_INPUT();
+    }
+    else
+    {
+      // Only when idle, so pasted text is not slowed down per character
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return decodeKey(std::span<const int>(chars, count));
+  }
+
+  TERM_DECL void setEchoOn()
+  {
+#ifdef __linux__
+    termios term = termUtils::savedTerm;
+    tcsetattr(STDIN_FILENO, TCSANOW, &term);
+#endif
+  }
+
+  TERM_DECL void setEchoOff()
+  {
+#ifdef __linux__
+    termios term = termUtils::savedTerm;
+    term.c_lflag &= ~(termUtils::TERM_FLAGS);
+    term.c_cc[VMIN] = 1;
+    term.c_cc[VTIME] = 0;
+
+    tcsetattr(STDIN_FILENO, TCSANOW, &term);
+#endif
+  }
+
+  TERM_DECL void initConsole()
+  {
+#ifdef __linux__
+    tcgetattr(STDIN_FILENO, &termUtils::savedTerm);
+    setEchoOff();
+#endif
+
+#ifdef _WIN32
+    DWORD outMode = 0;
+    DWORD inMode = 0;
+
+    termUtils::stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    termUtils::stdinHandle = GetStdHandle(STD_INPUT_HANDLE);
+
+    if (termUtils::stdoutHandle == INVALID_HANDLE_VALUE
+	|| termUtils::stdinHandle == INVALID_HANDLE_VALUE)
+    {
+      exit(GetLastError());
+    }
+
+    if (!GetConsoleMode(termUtils::stdoutHandle, &outMode)
+	|| !GetConsoleMode(termUtils::stdinHandle, &inMode))
+    {
+      exit(GetLastError());
+    }
+
+    termUtils::outModeInit = outMode;
+    termUtils::inModeInit = inMode;
+
+    // Enable ANSI escape codes
+    outMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
+
+    // Set stdin as no echo and unbuffered
+    inMode &= ~(ENABLE_ECHO_INPUT | ENABLE_LINE_INPUT);
+
+    if (!SetConsoleMode(termUtils::stdoutHandle, outMode)
+	|| !SetConsoleMode(termUtils::stdinHandle, inMode))
+    {
+      exit(GetLastError());
+    }
+
+    GetCurrentConsoleFontEx(termUtils::stdoutHandle, false, &termUtils::cfiOld);
+
+    CONSOLE_FONT_INFOEX cfi = { sizeof(CONSOLE_FONT_INFOEX) };
+    cfi.nFont = 0;
+    cfi.dwFontSize.X = 0;  // Width of each character in the font
+    cfi.dwFontSize.Y = 18; // Height
+    cfi.FontFamily = FF_DONTCARE;
+    cfi.FontWeight = FW_NORMAL;
+    std::wcscpy(cfi.FaceName, L"Cascadia Mono"); // Choose your font
+    SetCurrentConsoleFontEx(GetStdHandle(STD_OUTPUT_HANDLE), FALSE, &cfi);
+    // SetConsoleOutputCP(CP_UTF8);
+    SetConsoleOutputCP(65001);
+    SetConsoleCP(65001);
+#endif
+  }
+
+  TERM_DECL void restoreConsole(void)
+  {
+    std::cout << capabilities().softReset << capabilities().exitAttributes << std::flush;
+
+#ifdef _WIN32
+    // Reset console mode
+    if (!SetConsoleMode(termUtils::stdoutHandle, termUtils::outModeInit)
+	|| !SetConsoleMode(termUtils::stdinHandle, termUtils::inModeInit))
+    {
+      exit(GetLastError());
+    }
+    SetCurrentConsoleFontEx(GetStdHandle(STD_OUTPUT_HANDLE), FALSE,
+			    &termUtils::cfiOld);
+#endif
+#ifdef __linux__
+    tcsetattr(STDIN_FILENO, TCSANOW, &termUtils::savedTerm);
+#endif
+  }
+
+  namespace cursor
+  {
+    TERM_DECL Pos position()
+    {
+      std::cout << "\x1b[6n" << std::flush;
+      char buff[32] = { 0 };
+      int indx = 0;
+      while (indx < static_cast<int>(sizeof(buff)) - 1)
+      {
+	int cc = getchar();
+	if (cc == EOF)
+	{
+	  break;
+	}
+	buff[indx] = static_cast<char>(cc);
+	indx++;
+	if (cc == 'R')
+	{
+	  break;
+	}
+      }
+      // Ends the parsing below on a truncated reply
+      buff[std::max(indx, 1)] = 'R';
+      // Only digits and the separator are kept, then ROW;COL is parsed
+      indx = 0;
+      char str[32];
+      std::size_t size = 0;
+      char chr = buff[++indx];
+      while (chr != 'R')
+      {
+	if (std::find(termUtils::CHARS.begin(), termUtils::CHARS.end(), chr)
+	    != termUtils::CHARS.end())
+	{
+	  str[size++] = chr;
+	}
+	chr = buff[++indx];
+      }
+      int row = 0;
+      int col = 0;
+      const auto [end, ec] = std::from_chars(str, str + size, row);
+      if (ec == std::errc() && end < str + size && *end == ';')
+      {
+	std::from_chars(end + 1, str + size, col);
+      }
+      return Pos(row, col);
+    }
+  }
+
+}
+
+#endif // CONSOLE_HPP
@@ -0,0 +1,143 @@
+#ifndef FRAMEDIFF_HPP
+#define FRAMEDIFF_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "cell.hpp"
+#include "trace.hpp"
+#include "workPool.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Diff of two frames for very large grids
+   *
+   * Finding the changed rows is split across the threads of a WorkPool when
+   * the area is big, each row compared with termUtils::findDifference().
+   * The changed rows are then drawn in order on the calling thread, so the
+   * output is the same as Emitter::diff() and its cost follows the changed
+   * cells. Not thread safe.
+   */
+  class FrameDiff
+  {
+    public:
+      /**
+       * @brief Create a diff
+       *
+       * @param pool threads finding the changed rows, outliving the diff.
+       * nullptr to use the calling thread only
+       * @param parallelCells smallest area searched in parallel
+       */
+      explicit FrameDiff(WorkPool *pool = nullptr, const std::size_t parallelCells = 64 * 1024)
+	  : pool(pool), parallelCells(parallelCells)
+      {
+	// Built once, run() takes the function by reference at each frame
+	scanRows = [this](unsigned, const std::size_t begin, const std::size_t end)
+	{
+	  scan(begin, end);
+	};
+      }
+
+      FrameDiff(const FrameDiff&) = delete;
+      FrameDiff& operator=(const FrameDiff&) = delete;
+
+      /** @brief Change the threads finding the changed rows, nullptr for none */
+      void setPool(WorkPool *pool)
+      {
+	this->pool = pool;
+      }
+
+      /**
+       * @brief Draw the cells of a rectangle which differ between two
+       * buffers, like Emitter::diff()
+       *
+       * @param emitter emitter to draw with
+       * @param front cells currently on the terminal
+       * @param back cells to display, same size as front
+       * @param rect area to compare
+       * @return Number of rows changed
+       */
+      std::size_t draw(termUtils::Emitter& emitter, const CellBuffer& front, const CellBuffer& back, const Rect& rect)
+      {
+	TERM_TRACE_SCOPE(Diff);
+	find(front, back, rect);
+	for (std::size_t i = 0; i < first.size(); ++i)
+	{
+	  if (first[i] < right)
+	  {
+	    emitter.diffRow(front, back, area.row + i, first[i], right);
+	  }
+	}
+	return changed;
+      }
+
+      /**
+       * @brief Copy to front the rows the last draw() found changed
+       *
+       * @param front cells currently on the terminal, updated to back
+       * @param back cells drawn, same size as front
+       */
+      void update(CellBuffer& front, const CellBuffer& back) const
+      {
+	for (std::size_t i = 0; i < first.size(); ++i)
+	{
+	  if (first[i] < right)
+	  {
+	    const std::size_t r = area.row + i;
+	    std::copy(back.row(r) + first[i], back.row(r) + right, front.row(r) + first[i]);
+	  }
+	}
+      }
+
+    private:
+      WorkPool *pool;
+      std::size_t parallelCells;
+      WorkPool::Function scanRows;
+      const CellBuffer *a = nullptr;
+      const CellBuffer *b = nullptr;
+      Rect area;
+      std::size_t right = 0;
+      // First changed column of each row of the area, right if unchanged
+      std::vector<std::size_t> first;
+      std::size_t changed = 0;
+
+      /** @brief Fill first for the rows of a rectangle */
+      void find(const CellBuffer& front, const CellBuffer& back, const Rect& rect)
+      {
+	a = &front;
+	b = &back;
+	area = rect.intersect(Rect { 0, 0, back.rows(), back.cols() });
+	right = area.col + area.cols;
+	first.resize(area.rows);
+	if (pool != nullptr && pool->size() > 1 && area.rows * area.cols >= parallelCells)
+	{
+	  // About 4096 cells per chunk
+	  pool->run(area.rows, std::max<std::size_t>(1, 4096 / std::max<std::size_t>(area.cols, 1)), scanRows);
+	}
+	else
+	{
+	  scan(0, area.rows);
+	}
+	changed = static_cast<std::size_t>(std::count_if(first.begin(), first.end(), [this](const std::size_t c)
+	{
+	  return c < right;
+	}));
+      }
+
+      /** @brief Find the first changed column of rows [begin, end) of the area */
+      void scan(const std::size_t begin, const std::size_t end)
+      {
+	for (std::size_t i = begin; i < end; ++i)
+	{
+	  const std::size_t r = area.row + i;
+	  first[i] = termUtils::findDifference(a->row(r), b->row(r), area.col, right);
+	}
+      }
+  };
+
+}
+
+#endif // FRAMEDIFF_HPP
@@ -0,0 +1,624 @@
+#ifndef FUZZY_HPP
+#define FUZZY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "screen.hpp"
+#include "workPool.hpp"
+
+namespace termUtils
+{
+
+/** @brief Score of a candidate not matching a query */
+static constexpr int FUZZY_NO_MATCH = std::numeric_limits<int>::min();
+
+inline unsigned char fuzzyLower(const char c)
+{
+    const unsigned char u = static_cast<unsigned char>(c);
+    return u >= 'A' && u <= 'Z' ? static_cast<unsigned char>(u + 32) : u;
+}
+
+/**
+ * @brief Bit set of the bytes of a text, ignoring case
+ *
+ * Letters and digits have a bit each, other bytes share the remaining 28.
+ * A candidate can only match a query if its mask contains the query's one.
+ */
+inline std::uint64_t fuzzyMask(const std::string_view text)
+{
+    std::uint64_t mask = 0;
+    for(const char ch : text) {
+        const unsigned char c = fuzzyLower(ch);
+        unsigned bit;
+        if(c >= 'a' && c <= 'z') {
+            bit = c - 'a';
+        } else if(c >= '0' && c <= '9') {
+            bit = 26 + c - '0';
+        } else {
+            bit = 36 + c % 28;
+        }
+        mask |= std::uint64_t(1) << bit;
+    }
+    return mask;
+}
+
+/**
+ * @brief Position of a byte ignoring case, 16 bytes at a time with SSE2
+ *
+ * @param c lower case byte
+ * @return Position, npos if not found
+ */
+inline std::size_t fuzzyFind(const std::string_view text, std::size_t from, const unsigned char c)
+{
+    const unsigned char upper = c >= 'a' && c <= 'z' ? static_cast<unsigned char>(c - 32) : c;
+#ifdef __SSE2__
+    const __m128i lo = _mm_set1_epi8(static_cast<char>(c));
+    const __m128i up = _mm_set1_epi8(static_cast<char>(upper));
+    while(from + 16 <= text.size()) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + from));
+        const int found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, lo), _mm_cmpeq_epi8(bytes, up)));
+        if(found != 0) {
+            return from + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(found)));
+        }
+        from += 16;
+    }
+#endif
+    for(; from < text.size(); ++from) {
+        const unsigned char b = static_cast<unsigned char>(text[from]);
+        if(b == c || b == upper) {
+            return from;
+        }
+    }
+    return std::string_view::npos;
+}
+
+/** @brief Bonus of a match at a position: start of a word, path component or camel case hump */
+inline int fuzzyBonus(const std::string_view text, const std::size_t pos)
+{
+    if(pos == 0) {
+        return 10;
+    }
+    const char prev = text[pos - 1];
+    if(prev == '/' || prev == '\\') {
+        return 10;
+    }
+    if(prev == ' ' || prev == '_' || prev == '-' || prev == '.' || prev == ':') {
+        return 8;
+    }
+    if(prev >= 'a' && prev <= 'z' && text[pos] >= 'A' && text[pos] <= 'Z') {
+        return 7;
+    }
+    return 0;
+}
+
+/**
+ * @brief Score the query characters found in order in a text
+ *
+ * The match is searched forward, then narrowed to the shortest window
+ * ending at the same place. Matched characters score, word starts and
+ * consecutive matches add a bonus and gaps cost.
+ *
+ * @param text candidate
+ * @param query lower case query
+ * @param positions if not nullptr, receives the matched byte positions
+ * @return Score, higher is better, FUZZY_NO_MATCH if no match
+ */
+inline int fuzzyScore(const std::string_view text, const std::string_view query,
+                      std::vector<std::size_t>* positions = nullptr)
+{
+    std::size_t end = 0;
+    for(const char q : query) {
+        const std::size_t pos = fuzzyFind(text, end, static_cast<unsigned char>(q));
+        if(pos == std::string_view::npos) {
+            return FUZZY_NO_MATCH;
+        }
+        end = pos + 1;
+    }
+    std::size_t start = end;
+    for(std::size_t n = query.size(); n > 0;) {
+        --start;
+        if(fuzzyLower(text[start]) == static_cast<unsigned char>(query[n - 1])) {
+            --n;
+        }
+    }
+
+    int score = 0;
+    std::size_t prev = std::string_view::npos;
+    std::size_t n = 0;
+    for(std::size_t i = start; i < end && n < query.size(); ++i) {
+        if(fuzzyLower(text[i]) != static_cast<unsigned char>(query[n])) {
+            continue;
+        }
+        score += 16 + fuzzyBonus(text, i);
+        if(prev != std::string_view::npos) {
+            const std::size_t gap = i - prev - 1;
+            score += gap == 0 ? 8 : -static_cast<int>(std::min<std::size_t>(gap + 2, 32));
+        }
+        if(positions != nullptr) {
+            positions->push_back(i);
+        }
+        prev = i;
+        ++n;
+    }
+    return score;
+}
+
+};
+
+namespace term
+{
+
+  /** @brief Candidate matching a query */
+  struct FuzzyMatch
+  {
+      std::size_t index = 0;
+      int score = 0;
+  };
+
+  /**
+   * @brief Interactive fuzzy selection among many candidates
+   *
+   * Each query is searched on a background thread, the candidates being
+   * scored in parallel by a WorkPool. A bit mask of the characters of each
+   * candidate, computed when added, rejects most candidates before scoring.
+   * When the query extends the previous one, only the previous matches are
+   * searched; the match lists of the shorter queries are kept, so deleting a
+   * character is as fast. The candidates are searched by growing batches and
+   * the best matches so far are published after each one, so the first
+   * results show at once.
+   *
+   * Candidates, up to 2^32, are added before the first query. Queries
+   * ignore case.
+   */
+  class FuzzyFinder
+  {
+    public:
+      /**
+       * @brief Create a finder. The search thread starts with the first query
+       *
+       * @param threads scoring threads, 0 for the number of hardware threads
+       */
+      explicit FuzzyFinder(const unsigned threads = 0)
+	  : pool(threads), locals(pool.size())
+      {
+	starts.push_back(0);
+      }
+
+      FuzzyFinder(const FuzzyFinder&) = delete;
+      FuzzyFinder& operator=(const FuzzyFinder&) = delete;
+
+      ~FuzzyFinder()
+      {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  stopping = true;
+	  generation.fetch_add(1, std::memory_order_relaxed);
+	}
+	request.notify_one();
+	if (thread.joinable())
+	{
+	  thread.join();
+	}
+      }
+
+      /** @brief Reserve room for candidates of a total length */
+      void reserve(const std::size_t count, const std::size_t bytes)
+      {
+	text.reserve(bytes);
+	starts.reserve(count + 1);
+	masks.reserve(count);
+      }
+
+      /** @brief Add a candidate. Not after the first query */
+      void add(const std::string_view candidate)
+      {
+	text += candidate;
+	starts.push_back(text.size());
+	masks.push_back(termUtils::fuzzyMask(candidate));
+      }
+
+      /** @brief Number of candidates */
+      std::size_t size() const
+      {
+	return masks.size();
+      }
+
+      /** @brief Candidate n, in order of addition */
+      std::string_view operator[](const std::size_t n) const
+      {
+	return std::string_view(text.data() + starts[n], starts[n + 1] - starts[n]);
+      }
+
+      /**
+       * @brief Maximum number of best matches kept. Default is 100
+       *
+       * Set by attach() to fit the region. Not while searching.
+       */
+      void setLimit(const std::size_t count)
+      {
+	limit = std::max<std::size_t>(count, 1);
+      }
+
+      /**
+       * @brief Draw the results into a region on each update
+       *
+       * The best matches fill the region, the matched characters with the
+       * highlight style and the selected one with the selected style; the
+       * last row shows the number of matches. The search thread becomes the
+       * producer of the region. Not while searching.
+       *
+       * @param view region of a Screen, at least 2 rows high, outliving the finder
+       */
+      void attach(Region& view, const Style& normal = Style(), const Style& highlight = Style { color::DEFAULT,
+		  color::DEFAULT, attr::BRIGHT }, const Style& selected = Style { color::DEFAULT, color::DEFAULT,
+		  attr::REVERSE })
+      {
+	region = &view;
+	styles[0] = normal;
+	styles[1] = highlight;
+	styles[2] = selected;
+	setLimit(view.rect().rows > 1 ? view.rect().rows - 1 : 1);
+      }
+
+      /**
+       * @brief Search a query, replacing the search in progress
+       *
+       * Returns at once, the results come with results() and in the region.
+       */
+      void setQuery(const std::string_view query)
+      {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  pendingQuery.clear();
+	  for (const char c : query)
+	  {
+	    pendingQuery += static_cast<char>(termUtils::fuzzyLower(c));
+	  }
+	  generation.fetch_add(1, std::memory_order_relaxed);
+	  queryChanged = true;
+	  busy = true;
+	  if (!thread.joinable())
+	  {
+	    thread = std::thread(&FuzzyFinder::run, this);
+	  }
+	}
+	request.notify_one();
+      }
+
+      /** @brief Select a row of the results and redraw the region */
+      void select(const std::size_t row)
+      {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  selectedRow = row;
+	  redraw = region != nullptr;
+	  if (redraw && !thread.joinable())
+	  {
+	    thread = std::thread(&FuzzyFinder::run, this);
+	  }
+	}
+	request.notify_one();
+      }
+
+      /** @brief True until the last query is fully searched */
+      bool searching() const
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	return busy;
+      }
+
+      /** @brief Wait until the last query is fully searched */
+      void wait() const
+      {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return !busy; });
+      }
+
+      /** @brief Number of matches of the query, so far while searching */
+      std::size_t matched() const
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	return matchCount;
+      }
+
+      /** @brief Best matches so far, best first */
+      std::vector<FuzzyMatch> results() const
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	return best;
+      }
+
+    private:
+      // Candidates searched before publishing the first results
+      static constexpr std::size_t FIRST_BATCH = 1 << 16;
+      static constexpr std::size_t GRAIN = 4096;
+
+      /** @brief Matches of a query, kept to search its extensions */
+      struct Level
+      {
+	  std::string query;
+	  std::vector<std::uint32_t> matches;
+      };
+
+      /** @brief Results of one scoring thread */
+      struct alignas(64) Local
+      {
+	  std::vector<std::uint32_t> matches;
+	  // Heap of the best matches, the worst first
+	  std::vector<FuzzyMatch> best;
+      };
+
+      std::string text;
+      std::vector<std::size_t> starts;
+      std::vector<std::uint64_t> masks;
+      std::size_t limit = 100;
+
+      WorkPool pool;
+      std::vector<Local> locals;
+      // Search thread side
+      std::vector<Level> levels;
+      std::string query;
+
+      Region *region = nullptr;
+      Style styles[3];
+
+      std::thread thread;
+      mutable std::mutex mutex;
+      std::condition_variable request;
+      mutable std::condition_variable idle;
+      std::atomic<std::uint64_t> generation { 0 };
+      std::string pendingQuery;
+      bool queryChanged = false;
+      bool redraw = false;
+      bool busy = false;
+      bool stopping = false;
+      std::size_t selectedRow = 0;
+      std::size_t matchCount = 0;
+      std::vector<FuzzyMatch> best;
+
+      /** @brief Order of the results: score, then shorter, then first added */
+      bool better(const FuzzyMatch& a, const FuzzyMatch& b) const
+      {
+	if (a.score != b.score)
+	{
+	  return a.score > b.score;
+	}
+	const std::size_t la = starts[a.index + 1] - starts[a.index];
+	const std::size_t lb = starts[b.index + 1] - starts[b.index];
+	return la != lb ? la < lb : a.index < b.index;
+      }
+
+      void run()
+      {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+	  request.wait(lock, [this] { return stopping || queryChanged || redraw; });
+	  if (stopping)
+	  {
+	    return;
+	  }
+	  if (queryChanged)
+	  {
+	    query = pendingQuery;
+	    const std::uint64_t gen = generation.load(std::memory_order_relaxed);
+	    queryChanged = false;
+	    redraw = false;
+	    lock.unlock();
+	    search(gen);
+	    lock.lock();
+	  }
+	  else
+	  {
+	    redraw = false;
+	    lock.unlock();
+	    draw();
+	    lock.lock();
+	  }
+	}
+      }
+
+      /** @brief Search the query, until replaced by another one */
+      void search(const std::uint64_t gen)
+      {
+	while (!levels.empty() && query.compare(0, levels.back().query.size(), levels.back().query) != 0)
+	{
+	  levels.pop_back();
+	}
+	if (query.empty())
+	{
+	  std::vector<FuzzyMatch> first;
+	  for (std::size_t i = 0; i < std::min(limit, size()); ++i)
+	  {
+	    first.push_back(FuzzyMatch { i, 0 });
+	  }
+	  publish(std::move(first), size(), true);
+	  return;
+	}
+
+	const std::vector<std::uint32_t> *source = levels.empty() ? nullptr : &levels.back().matches;
+	const std::size_t total = source != nullptr ? source->size() : size();
+	const std::uint64_t mask = termUtils::fuzzyMask(query);
+	for (Local& local : locals)
+	{
+	  local.matches.clear();
+	  local.best.clear();
+	}
+	const auto worse = [this](const FuzzyMatch& a, const FuzzyMatch& b) { return better(a, b); };
+
+	std::size_t done = 0;
+	std::size_t batch = FIRST_BATCH;
+	do
+	{
+	  const std::size_t offset = done;
+	  const std::size_t count = std::min(batch, total - done);
+	  pool.run(count, GRAIN, [&](const unsigned worker, const std::size_t begin, const std::size_t end)
+	  {
+	    if (generation.load(std::memory_order_relaxed) != gen)
+	    {
+	      return;
+	    }
+	    Local& local = locals[worker];
+	    for (std::size_t i = offset + begin; i < offset + end; ++i)
+	    {
+	      const std::size_t index = source != nullptr ? (*source)[i] : i;
+	      if ((masks[index] & mask) != mask)
+	      {
+		continue;
+	      }
+	      const int score = termUtils::fuzzyScore((*this)[index], query);
+	      if (score == termUtils::FUZZY_NO_MATCH)
+	      {
+		continue;
+	      }
+	      local.matches.push_back(static_cast<std::uint32_t>(index));
+	      const FuzzyMatch match { index, score };
+	      if (local.best.size() < limit)
+	      {
+		local.best.push_back(match);
+		std::push_heap(local.best.begin(), local.best.end(), worse);
+	      }
+	      else if (better(match, local.best.front()))
+	      {
+		std::pop_heap(local.best.begin(), local.best.end(), worse);
+		local.best.back() = match;
+		std::push_heap(local.best.begin(), local.best.end(), worse);
+	      }
+	    }
+	  });
+	  if (generation.load(std::memory_order_relaxed) != gen)
+	  {
+	    return;
+	  }
+	  done += count;
+	  batch *= 2;
+
+	  std::vector<FuzzyMatch> merged;
+	  std::size_t found = 0;
+	  for (const Local& local : locals)
+	  {
+	    merged.insert(merged.end(), local.best.begin(), local.best.end());
+	    found += local.matches.size();
+	  }
+	  const std::size_t keep = std::min(limit, merged.size());
+	  std::partial_sort(merged.begin(), merged.begin() + static_cast<std::ptrdiff_t>(keep), merged.end(), worse);
+	  merged.resize(keep);
+	  publish(std::move(merged), found, done == total);
+	}
+	while (done < total);
+
+	if (levels.empty() || levels.back().query != query)
+	{
+	  Level level { query, {} };
+	  for (const Local& local : locals)
+	  {
+	    level.matches.insert(level.matches.end(), local.matches.begin(), local.matches.end());
+	  }
+	  levels.push_back(std::move(level));
+	}
+      }
+
+      void publish(std::vector<FuzzyMatch>&& results, const std::size_t found, const bool complete)
+      {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  best = std::move(results);
+	  matchCount = found;
+	  if (complete && !queryChanged)
+	  {
+	    busy = false;
+	    idle.notify_all();
+	  }
+	}
+	draw();
+      }
+
+      /** @brief Draw the results into the region. Only called by the search thread */
+      void draw()
+      {
+	if (region == nullptr)
+	{
+	  return;
+	}
+	std::vector<FuzzyMatch> shown;
+	std::size_t found;
+	std::size_t selected;
+	bool partial;
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  shown = best;
+	  found = matchCount;
+	  selected = selectedRow;
+	  partial = busy;
+	}
+
+	const Rect& rc = region->rect();
+	region->fill(Cell { U' ', styles[0] });
+	std::vector<std::size_t> positions;
+	for (std::size_t row = 0; row < shown.size() && row + 1 < rc.rows; ++row)
+	{
+	  const std::string_view candidate = (*this)[shown[row].index];
+	  const Style& base = styles[row == selected ? 2 : 0];
+	  if (row == selected)
+	  {
+	    region->buffer().fill(Rect { row, 0, 1, rc.cols }, Cell { U' ', base });
+	  }
+	  positions.clear();
+	  termUtils::fuzzyScore(candidate, query, &positions);
+	  Style mark = styles[1];
+	  mark.attrs |= base.attrs;
+
+	  // Runs of matched and unmatched bytes
+	  std::size_t col = 0;
+	  std::size_t pos = 0;
+	  std::size_t next = 0;
+	  while (pos < candidate.size() && col < rc.cols)
+	  {
+	    const bool matched = next < positions.size() && positions[next] == pos;
+	    std::size_t end = pos;
+	    while (end < candidate.size() && (next < positions.size() && positions[next] == end) == matched)
+	    {
+	      next += matched ? 1 : 0;
+	      ++end;
+	    }
+	    // Keep UTF-8 sequences whole
+	    while (end < candidate.size() && (static_cast<unsigned char>(candidate[end]) & 0xC0) == 0x80)
+	    {
+	      ++end;
+	    }
+	    while (next < positions.size() && positions[next] < end)
+	    {
+	      ++next;
+	    }
+	    col = region->print(row, col, candidate.substr(pos, end - pos), matched ? mark : base);
+	    pos = end;
+	  }
+	}
+
+	std::string status = std::to_string(found) + '/' + std::to_string(size());
+	if (partial)
+	{
+	  status += " ...";
+	}
+	region->print(rc.rows - 1, 0, status, styles[0]);
+	region->commit();
+      }
+  };
+
+}
+
+#endif // FUZZY_HPP
@@ -0,0 +1,428 @@
+#ifndef KEYMAP_HPP
+#define KEYMAP_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+#include "term.hpp"
+#include "trace.hpp"
+
+namespace term
+{
+
+  /** @brief One entry of a binding table */
+  struct Binding
+  {
+      /** @brief Mode the binding belongs to, e.g. "normal" */
+      std::string_view mode;
+      /**
+       * @brief Keys separated by spaces, e.g. "C-x C-s"
+       *
+       * A key is a letter, digit, / . + -, or a name among Escape, Enter,
+       * Tab, Space, Backspace, Up, Down, Left, Right, Home, End, PageUp,
+       * PageDown, Insert, Delete and F1 to F12. Prefixes C-, M- and S- add
+       * Control, Alt and Shift; an upper case letter implies Shift.
+       */
+      std::string_view keys;
+      /** @brief Action returned by the dispatcher, 0 or more */
+      int action;
+  };
+
+  namespace binding
+  {
+    /** @brief The key is not bound */
+    inline constexpr int NONE = -1;
+    /** @brief The key starts or continues a chord */
+    inline constexpr int PENDING = -2;
+  }
+
+}
+
+namespace termUtils
+{
+
+/** @brief Longest chord of a binding */
+static constexpr std::size_t MAX_CHORD = 4;
+
+/** @brief Key and modifiers packed in an integer */
+constexpr std::uint32_t keyId(const term::Key code, const int modifiers)
+{
+    return (static_cast<std::uint32_t>(static_cast<int>(code)) & 0xFFFF) | static_cast<std::uint32_t>(modifiers) << 16;
+}
+
+/** @brief Key id of a key name, see term::Binding::keys */
+constexpr std::uint32_t parseKeyName(std::string_view name)
+{
+    int modifiers = term::modifier::NONE;
+    while(name.size() > 2 && name[1] == '-') {
+        if(name[0] == 'C') {
+            modifiers |= term::modifier::CTRL;
+        } else if(name[0] == 'M' || name[0] == 'A') {
+            modifiers |= term::modifier::ALT;
+        } else if(name[0] == 'S') {
+            modifiers |= term::modifier::SHIFT;
+        } else {
+            throw std::invalid_argument("keymap: unknown modifier");
+        }
+        name.remove_prefix(2);
+    }
+
+    if(name.size() == 1) {
+        const char c = name[0];
+        if(c >= 'a' && c <= 'z') {
+            return keyId(static_cast<term::Key>(static_cast<int>(term::Key::A) + c - 'a'), modifiers);
+        }
+        if(c >= 'A' && c <= 'Z') {
+            return keyId(static_cast<term::Key>(static_cast<int>(term::Key::A) + c - 'A'),
+                         modifiers | term::modifier::SHIFT);
+        }
+        if(c >= '0' && c <= '9') {
+            return keyId(static_cast<term::Key>(static_cast<int>(term::Key::Num0) + c - '0'), modifiers);
+        }
+        switch(c) {
+        case '/':
+            return keyId(term::Key::Slash, modifiers);
+        case '.':
+            return keyId(term::Key::Point, modifiers);
+        case '+':
+            return keyId(term::Key::Add, modifiers);
+        case '-':
+            return keyId(term::Key::Subtsract, modifiers);
+        }
+    }
+
+    struct Name {
+        std::string_view name;
+        term::Key code;
+    };
+    constexpr Name NAMES[] = {
+        { "Escape", term::Key::Escape }, { "Esc", term::Key::Escape }, { "Enter", term::Key::Enter },
+        { "Tab", term::Key::Tab }, { "Space", term::Key::Space }, { "Backspace", term::Key::Backspace },
+        { "Up", term::Key::Up }, { "Down", term::Key::Down }, { "Left", term::Key::Left },
+        { "Right", term::Key::Right }, { "Home", term::Key::Home }, { "End", term::Key::End },
+        { "PageUp", term::Key::PageUp }, { "PageDown", term::Key::PageDown }, { "Insert", term::Key::Insert },
+        { "Delete", term::Key::Delete }, { "F1", term::Key::F1 }, { "F2", term::Key::F2 }, { "F3", term::Key::F3 },
+        { "F4", term::Key::F4 }, { "F5", term::Key::F5 }, { "F6", term::Key::F6 }, { "F7", term::Key::F7 },
+        { "F8", term::Key::F8 }, { "F9", term::Key::F9 }, { "F10", term::Key::F10 }, { "F11", term::Key::F11 },
+        { "F12", term::Key::F12 }
+    };
+    for(const Name& n : NAMES) {
+        if(n.name == name) {
+            return keyId(n.code, modifiers);
+        }
+    }
+    throw std::invalid_argument("keymap: unknown key name");
+}
+
+};
+
+namespace term
+{
+
+  /**
+   * @brief Bindings of all modes compiled into a trie
+   *
+   * Built from a table in a constant expression: invalid key names and
+   * duplicate bindings fail the build. Trie edges live in a flat open
+   * addressing table, so following an edge takes a hash and a few probes.
+   *
+   * constexpr term::Binding BINDINGS[] = { { "normal", "C-x C-s", SAVE }, ... };
+   * constexpr term::Keymap KEYMAP(BINDINGS);
+   */
+  template <std::size_t N>
+  class Keymap
+  {
+    public:
+      constexpr explicit Keymap(const Binding (&table)[N])
+      {
+	for (const Binding& b : table)
+	{
+	  if (b.action < 0)
+	  {
+	    throw std::invalid_argument("keymap: actions must not be negative");
+	  }
+	  std::size_t node = root(b.mode);
+	  std::size_t start = 0;
+	  std::size_t length = 0;
+	  while (start < b.keys.size())
+	  {
+	    std::size_t end = start;
+	    while (end < b.keys.size() && b.keys[end] != ' ')
+	    {
+	      ++end;
+	    }
+	    if (end > start)
+	    {
+	      if (++length > termUtils::MAX_CHORD)
+	      {
+		throw std::length_error("keymap: chord too long");
+	      }
+	      node = child(node, termUtils::parseKeyName(b.keys.substr(start, end - start)));
+	    }
+	    start = end + 1;
+	  }
+	  if (length == 0)
+	  {
+	    throw std::invalid_argument("keymap: binding without key");
+	  }
+	  if (nodes[node].action != binding::NONE)
+	  {
+	    throw std::invalid_argument("keymap: duplicate binding");
+	  }
+	  nodes[node].action = b.action;
+	}
+      }
+
+      /**
+       * @brief Index of a mode
+       * @return The index, -1 if no binding uses the mode
+       */
+      constexpr int mode(const std::string_view name) const
+      {
+	for (std::size_t i = 0; i < modeCount; ++i)
+	{
+	  if (modes[i].name == name)
+	  {
+	    return static_cast<int>(i);
+	  }
+	}
+	return -1;
+      }
+
+      /** @brief Root node of a mode index */
+      constexpr std::size_t rootOf(const int mode) const
+      {
+	return modes[static_cast<std::size_t>(mode)].root;
+      }
+
+      /**
+       * @brief Follow a trie edge
+       * @return The child node, or NO_NODE
+       */
+      constexpr std::size_t next(const std::size_t node, const std::uint32_t key) const
+      {
+	for (std::size_t i = hash(node, key);; i = (i + 1) & (SLOTS - 1))
+	{
+	  if (slots[i].child == NO_NODE || (slots[i].node == node && slots[i].key == key))
+	  {
+	    return slots[i].child;
+	  }
+	}
+      }
+
+      /** @brief Action bound to a node, binding::NONE if none */
+      constexpr int action(const std::size_t node) const
+      {
+	return nodes[node].action;
+      }
+
+      /** @brief True if chords continue after a node */
+      constexpr bool hasChildren(const std::size_t node) const
+      {
+	return nodes[node].children != 0;
+      }
+
+      static constexpr std::size_t NO_NODE = static_cast<std::size_t>(-1);
+
+    private:
+      // A root per mode and one node per key of each binding at most
+      static constexpr std::size_t NODES = N * (termUtils::MAX_CHORD + 1);
+      static constexpr std::size_t SLOTS = [] {
+	std::size_t n = 1;
+	while (n < N * termUtils::MAX_CHORD * 2)
+	{
+	  n *= 2;
+	}
+	return n;
+      }();
+
+      struct Mode
+      {
+	  std::string_view name;
+	  std::size_t root = 0;
+      };
+
+      struct Node
+      {
+	  int action = binding::NONE;
+	  std::size_t children = 0;
+      };
+
+      struct Slot
+      {
+	  std::size_t node = 0;
+	  std::uint32_t key = 0;
+	  std::size_t child = NO_NODE;
+      };
+
+      Mode modes[N] {};
+      std::size_t modeCount = 0;
+      Node nodes[NODES] {};
+      std::size_t nodeCount = 0;
+      Slot slots[SLOTS] {};
+
+      static constexpr std::size_t hash(const std::size_t node, const std::uint32_t key)
+      {
+	std::uint64_t h = (std::uint64_t(node) << 32 | key) * 0x9e3779b97f4a7c15ull;
+	return static_cast<std::size_t>(h >> 40) & (SLOTS - 1);
+      }
+
+      constexpr std::size_t root(const std::string_view name)
+      {
+	const int index = mode(name);
+	if (index >= 0)
+	{
+	  return modes[static_cast<std::size_t>(index)].root;
+	}
+	modes[modeCount++] = Mode { name, nodeCount };
+	return nodeCount++;
+      }
+
+      /** @brief Child of a node by a key, created if missing */
+      constexpr std::size_t child(const std::size_t node, const std::uint32_t key)
+      {
+	std::size_t i = hash(node, key);
+	while (slots[i].child != NO_NODE)
+	{
+	  if (slots[i].node == node && slots[i].key == key)
+	  {
+	    return slots[i].child;
+	  }
+	  i = (i + 1) & (SLOTS - 1);
+	}
+	slots[i] = Slot { node, key, nodeCount };
+	++nodes[node].children;
+	return nodeCount++;
+      }
+  };
+
+  /**
+   * @brief Turns key events into actions with a Keymap
+   *
+   * Keys of a chord return binding::PENDING. A chord left unfinished for
+   * longer than the timeout is abandoned on the next key, or resolved by
+   * expire() to the action of the keys typed so far if any, so both "g" and
+   * "g g" can be bound. A key which does not continue a chord is looked up
+   * again from the root. No allocation.
+   */
+  template <std::size_t N>
+  class KeyDispatcher
+  {
+    public:
+      using Clock = std::chrono::steady_clock;
+
+      /**
+       * @brief Create a dispatcher
+       *
+       * @param keymap bindings, outliving the dispatcher
+       * @param mode initial mode
+       * @param timeout time allowed between the keys of a chord. Default is 1s
+       */
+      KeyDispatcher(const Keymap<N>& keymap, const std::string_view mode,
+		    const Clock::duration timeout = std::chrono::seconds(1))
+	  : keymap(keymap), timeout(timeout)
+      {
+	setMode(mode);
+      }
+
+      /**
+       * @brief Switch to another mode, abandoning a pending chord
+       * @return False if no binding uses the mode
+       */
+      bool setMode(const std::string_view mode)
+      {
+	const int index = keymap.mode(mode);
+	if (index < 0)
+	{
+	  return false;
+	}
+	current = index;
+	node = keymap.rootOf(index);
+	return true;
+      }
+
+      /** @brief Index of the current mode, see Keymap::mode() */
+      int mode() const
+      {
+	return current;
+      }
+
+      /**
+       * @brief Action of a key
+       *
+       * @param key key event
+       * @param now time of the event. Default is now
+       * @return Action, binding::NONE or binding::PENDING
+       */
+      int dispatch(const KeyEvent& key, const Clock::time_point now = Clock::now())
+      {
+	TERM_TRACE_SCOPE(Dispatch);
+	const std::size_t root = keymap.rootOf(current);
+	if (node != root && now - last > timeout)
+	{
+	  node = root;
+	}
+	const std::uint32_t id = termUtils::keyId(key.code, key.modifiers);
+	std::size_t next = keymap.next(node, id);
+	if (next == Keymap<N>::NO_NODE && node != root)
+	{
+	  next = keymap.next(root, id);
+	}
+	if (next == Keymap<N>::NO_NODE)
+	{
+	  node = root;
+	  return binding::NONE;
+	}
+	if (keymap.hasChildren(next))
+	{
+	  node = next;
+	  last = now;
+	  return binding::PENDING;
+	}
+	node = root;
+	return keymap.action(next);
+      }
+
+      /** @brief True while a chord is unfinished */
+      bool pending() const
+      {
+	return node != keymap.rootOf(current);
+      }
+
+      /** @brief Time when expire() resolves the pending chord */
+      Clock::time_point deadline() const
+      {
+	return last + timeout;
+      }
+
+      /**
+       * @brief Resolve a chord left unfinished past the timeout
+       *
+       * @param now current time. Default is now
+       * @return Action bound to the keys typed, binding::NONE if none or if
+       * nothing expired
+       */
+      int expire(const Clock::time_point now = Clock::now())
+      {
+	if (!pending() || now - last <= timeout)
+	{
+	  return binding::NONE;
+	}
+	const int action = keymap.action(node);
+	node = keymap.rootOf(current);
+	return action;
+      }
+
+    private:
+      const Keymap<N>& keymap;
+      Clock::duration timeout;
+      int current = 0;
+      std::size_t node = 0;
+      Clock::time_point last;
+  };
+
+}
+
+#endif // KEYMAP_HPP
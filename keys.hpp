@@ -107,7 +107,8 @@ enum class Key : int {
     F13,       // The F13 key
     F14,       // The F14 key
     F15,       // The F15 key
-    Pause      // The Pause key
+    Pause,     // The Pause key
+    Text       // A non ASCII character, see KeyEvent::codepoint
 };
 
 };
@@ -0,0 +1,847 @@
+#ifndef LINEEDITOR_HPP
+#define LINEEDITOR_HPP
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cell.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Command history in an append-only file
+   *
+   * Entries are lines of the history file. A second file, the history path
+   * with ".idx" appended, holds the 64 bit offset of each entry so that
+   * opening does not scan the history; entries missing from it, written by
+   * another tool, are indexed when opening. Both files are memory mapped.
+   * Writers take an exclusive flock() on the history file, so several
+   * shells can share it; entries they add are seen on the next add().
+   *
+   * search() keeps a bit set of the bytes and byte pairs of each entry,
+   * built on the first search, and reads only the entries whose set holds
+   * the query's one.
+   */
+  class History
+  {
+    public:
+      History()
+      {
+      }
+
+      History(const History&) = delete;
+      History& operator=(const History&) = delete;
+
+      ~History()
+      {
+	close();
+      }
+
+      /**
+       * @brief Open or create a history file
+       *
+       * @param path history file
+       * @return False if the files cannot be opened
+       */
+      bool open(const std::string& path)
+      {
+	close();
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	indexFd = ::open((path + ".idx").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (fd < 0 || indexFd < 0)
+	{
+	  close();
+	  return false;
+	}
+	flock(fd, LOCK_EX);
+	remap();
+
+	// Keep the index entries pointing to line starts, index the rest
+	struct stat st;
+	fstat(indexFd, &st);
+	std::size_t count = static_cast<std::size_t>(st.st_size) / sizeof(std::uint64_t);
+	if (count > 0 && mapIndex(count))
+	{
+	  while (count > 0 && !lineStart(offsets[count - 1]))
+	  {
+	    --count;
+	  }
+	}
+	else
+	{
+	  count = 0;
+	}
+	if (count * sizeof(std::uint64_t) != static_cast<std::size_t>(st.st_size))
+	{
+	  if (ftruncate(indexFd, static_cast<off_t>(count * sizeof(std::uint64_t))) != 0)
+	  {
+	    close();
+	    return false;
+	  }
+	}
+	indexed = count;
+
+	std::size_t pos = 0;
+	if (count > 0)
+	{
+	  pos = nextLine(static_cast<std::size_t>(offsets[count - 1]));
+	}
+	indexFrom(pos);
+	syncIndex();
+	flock(fd, LOCK_UN);
+	return true;
+      }
+
+      void close()
+      {
+	if (data != nullptr)
+	{
+	  munmap(const_cast<char*>(data), length);
+	  data = nullptr;
+	}
+	if (offsets != nullptr)
+	{
+	  munmap(const_cast<std::uint64_t*>(offsets), mappedIndex);
+	  offsets = nullptr;
+	}
+	if (fd >= 0)
+	{
+	  ::close(fd);
+	}
+	if (indexFd >= 0)
+	{
+	  ::close(indexFd);
+	}
+	fd = -1;
+	indexFd = -1;
+	length = 0;
+	indexed = 0;
+	recent.clear();
+	masks.clear();
+      }
+
+      /** @brief Number of entries */
+      std::size_t size() const
+      {
+	return indexed + recent.size();
+      }
+
+      /** @brief Entry n, oldest first */
+      std::string_view operator[](const std::size_t n) const
+      {
+	const std::size_t start = offset(n);
+	return std::string_view(data + start, end(n) - start);
+      }
+
+      /**
+       * @brief Append an entry, unless empty or equal to the last one
+       *
+       * @param line entry, new lines are replaced by spaces
+       * @return False on write error
+       */
+      bool add(std::string_view line)
+      {
+	if (fd < 0 || line.empty() || (size() > 0 && (*this)[size() - 1] == line))
+	{
+	  return true;
+	}
+	std::string entry(line);
+	std::replace(entry.begin(), entry.end(), '\n', ' ');
+	entry += '\n';
+	if (flock(fd, LOCK_EX) != 0)
+	{
+	  return false;
+	}
+	const bool written = append(entry);
+	flock(fd, LOCK_UN);
+	return written;
+      }
+
+      /**
+       * @brief Newest entry containing a text, before an entry
+       *
+       * Searching again from the last match while the text grows visits
+       * each entry once per search. The first search reads every entry to
+       * build the bit sets, later ones only the entries added since.
+       *
+       * @param text text to find
+       * @param before search entries before this one, size() for all
+       * @return Index of the entry, size() if not found
+       */
+      std::size_t search(std::string_view text, std::size_t before) const
+      {
+	masks.reserve(size());
+	while (masks.size() < size())
+	{
+	  masks.push_back(mask((*this)[masks.size()]));
+	}
+	const Mask wanted = mask(text);
+	before = std::min(before, size());
+	while (before > 0)
+	{
+	  --before;
+	  const Mask& m = masks[before];
+	  if ((m.bytes & wanted.bytes) == wanted.bytes && (m.pairs & wanted.pairs) == wanted.pairs
+	      && (*this)[before].find(text) != std::string_view::npos)
+	  {
+	    return before;
+	  }
+	}
+	return size();
+      }
+
+    private:
+      /** @brief Bits of the bytes and of the pairs of adjacent bytes of a text */
+      struct Mask
+      {
+	  std::uint64_t bytes;
+	  std::uint64_t pairs;
+      };
+
+      int fd = -1;
+      int indexFd = -1;
+      const char *data = nullptr;
+      std::size_t length = 0;
+      // Offsets mapped from the index file
+      const std::uint64_t *offsets = nullptr;
+      std::size_t mappedIndex = 0;
+      std::size_t indexed = 0;
+      // Offsets appended since opening
+      std::vector<std::uint64_t> recent;
+      // Bit sets of the entries, filled by search()
+      mutable std::vector<Mask> masks;
+
+      static Mask mask(const std::string_view text)
+      {
+	Mask m { 0, 0 };
+	unsigned pair = 0;
+	for (std::size_t i = 0; i < text.size(); ++i)
+	{
+	  const unsigned c = static_cast<unsigned char>(text[i]);
+	  pair = ((pair << 8) | c) & 0xFFFF;
+	  m.bytes |= std::uint64_t(1) << ((c & 63) ^ (c >> 6));
+	  if (i > 0)
+	  {
+	    // Top 6 bits of a multiplicative hash
+	    m.pairs |= std::uint64_t(1) << ((pair * 0x9E3779B1u) >> 26);
+	  }
+	}
+	return m;
+      }
+
+      std::size_t offset(const std::size_t n) const
+      {
+	return static_cast<std::size_t>(n < indexed ? offsets[n] : recent[n - indexed]);
+      }
+
+      /** @brief End of entry n, before its new line */
+      std::size_t end(const std::size_t n) const
+      {
+	const std::size_t next = n + 1 < size() ? offset(n + 1) : length;
+	return next > 0 && data[next - 1] == '\n' ? next - 1 : next;
+      }
+
+      bool lineStart(const std::uint64_t pos) const
+      {
+	return pos < length && (pos == 0 || data[pos - 1] == '\n');
+      }
+
+      /** @brief Start of the line after the one at pos */
+      std::size_t nextLine(const std::size_t pos) const
+      {
+	const void *nl = std::memchr(data + pos, '\n', length - pos);
+	return nl != nullptr ? static_cast<std::size_t>(static_cast<const char*>(nl) - data) + 1 : length;
+      }
+
+      /** @brief Add the lines from pos to the end of the mapping to the entries */
+      void indexFrom(std::size_t pos)
+      {
+	while (pos < length)
+	{
+	  recent.push_back(pos);
+	  pos = nextLine(pos);
+	}
+      }
+
+      /** @brief Write the offsets missing from the index file. Called under the lock */
+      void syncIndex()
+      {
+	struct stat st;
+	fstat(indexFd, &st);
+	for (std::size_t n = static_cast<std::size_t>(st.st_size) / sizeof(std::uint64_t); n < size(); ++n)
+	{
+	  const std::uint64_t value = offset(n);
+	  if (::write(indexFd, &value, sizeof(value)) != sizeof(value))
+	  {
+	    // The index is rebuilt from the history on next open
+	    ftruncate(indexFd, 0);
+	    return;
+	  }
+	}
+      }
+
+      /** @brief Append an entry ending with a new line. Called under the lock */
+      bool append(std::string& entry)
+      {
+	const off_t end = lseek(fd, 0, SEEK_END);
+	if (end < 0)
+	{
+	  return false;
+	}
+	// Entries added by other processes since the last remap
+	const std::size_t known = length;
+	remap();
+	if (length != static_cast<std::size_t>(end))
+	{
+	  return false;
+	}
+	indexFrom(known > 0 && data[known - 1] != '\n' ? nextLine(known) : known);
+	std::size_t start = static_cast<std::size_t>(end);
+	if (start > 0 && data[start - 1] != '\n')
+	{
+	  entry.insert(entry.begin(), '\n');
+	  ++start;
+	}
+	if (::write(fd, entry.data(), entry.size()) != static_cast<ssize_t>(entry.size()))
+	{
+	  return false;
+	}
+	recent.push_back(start);
+	remap();
+	syncIndex();
+	return true;
+      }
+
+      void remap()
+      {
+	if (data != nullptr)
+	{
+	  munmap(const_cast<char*>(data), length);
+	  data = nullptr;
+	}
+	struct stat st;
+	fstat(fd, &st);
+	length = static_cast<std::size_t>(st.st_size);
+	if (length > 0)
+	{
+	  void *addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	  data = addr != MAP_FAILED ? static_cast<const char*>(addr) : nullptr;
+	  length = data != nullptr ? length : 0;
+	}
+      }
+
+      bool mapIndex(const std::size_t count)
+      {
+	mappedIndex = count * sizeof(std::uint64_t);
+	void *addr = mmap(nullptr, mappedIndex, PROT_READ, MAP_SHARED, indexFd, 0);
+	offsets = addr != MAP_FAILED ? static_cast<const std::uint64_t*>(addr) : nullptr;
+	return offsets != nullptr;
+      }
+  };
+
+  /**
+   * @brief Single line input with editing, history and completion
+   *
+   * Feed it key events from keyPress() or nextKey(). Each edit redraws only
+   * the part of the line after the first changed character. Characters are
+   * taken one column wide and the line is not wrapped.
+   *
+   * Keys: Left, Right, Ctrl-A, Ctrl-E move; Backspace, Ctrl-D, Ctrl-K,
+   * Ctrl-U, Ctrl-W delete; Up and Down browse the history; Ctrl-R searches
+   * it; Tab completes; Enter accepts; Ctrl-C cancels; Ctrl-D on an empty
+   * line ends the input.
+   */
+  class LineEditor
+  {
+    public:
+      enum class Status
+      {
+	Editing,
+	Done,
+	Cancelled,
+	EndOfFile
+      };
+
+      /**
+       * @brief Candidates completing the word before the cursor
+       *
+       * Runs on a detached thread with a copy of the line and must not
+       * throw. Tab is ignored while a completion runs.
+       */
+      using Completer = std::function<std::vector<std::string>(std::string_view line, std::size_t cursor)>;
+
+      /**
+       * @brief Create an editor
+       *
+       * @param prompt text before the line
+       * @param history history outliving the editor, nullptr for none
+       */
+      explicit LineEditor(std::string prompt, History *history = nullptr)
+	  : prompt(std::move(prompt)), history(history)
+      {
+      }
+
+      void setCompleter(Completer completer)
+      {
+	complete = std::move(completer);
+      }
+
+      /** @brief Current line */
+      const std::string& line() const
+      {
+	return text;
+      }
+
+      /**
+       * @brief Start editing a new line and show the prompt
+       *
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       */
+      void start(std::ostream& os = std::cout, const bool flush = true)
+      {
+	text.clear();
+	cursor = 0;
+	browsing = history != nullptr ? history->size() : 0;
+	searching = false;
+	++generation;
+	shownPrompt.clear();
+	redraw(os, flush);
+      }
+
+      /**
+       * @brief Handle a key
+       *
+       * @param key key event
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       * @return Editing until the line is accepted or cancelled
+       */
+      Status feed(const KeyEvent& key, std::ostream& os = std::cout, const bool flush = true)
+      {
+	const bool ctrl = (key.modifiers & modifier::CTRL) != 0;
+	if (searching && !handleSearch(key, ctrl))
+	{
+	  redraw(os, flush);
+	  return Status::Editing;
+	}
+
+	Status status = Status::Editing;
+	if (key.code == Key::Enter)
+	{
+	  if (history != nullptr)
+	  {
+	    history->add(text);
+	  }
+	  status = Status::Done;
+	}
+	else if (ctrl && key.code == Key::C)
+	{
+	  status = Status::Cancelled;
+	}
+	else if (ctrl && key.code == Key::D && text.empty())
+	{
+	  status = Status::EndOfFile;
+	}
+	else if (key.length != 0 && !ctrl && (key.modifiers & modifier::ALT) == 0)
+	{
+	  insert(key.text());
+	}
+	else
+	{
+	  edit(key, ctrl);
+	}
+
+	redraw(os, false);
+	if (status != Status::Editing)
+	{
+	  static constexpr std::string_view NEWLINE("\r\n");
+	  os.write(NEWLINE.data(), NEWLINE.size());
+	  ++generation;
+	}
+	if (flush)
+	{
+	  os << std::flush;
+	}
+	return status;
+      }
+
+      /**
+       * @brief Apply a finished completion, call when idle
+       *
+       * Completions of a line changed meanwhile are dropped.
+       *
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       * @return True if the line changed
+       */
+      bool poll(std::ostream& os = std::cout, const bool flush = true)
+      {
+	std::vector<std::string> candidates;
+	{
+	  std::lock_guard<std::mutex> lock(completion->mutex);
+	  if (!completion->ready)
+	  {
+	    return false;
+	  }
+	  completion->ready = false;
+	  candidates = std::move(completion->candidates);
+	  if (completion->generation != generation || candidates.empty())
+	  {
+	    return false;
+	  }
+	}
+	const std::size_t start = wordStart();
+	const std::string_view word(text.data() + start, cursor - start);
+	std::string_view common = candidates[0];
+	for (const std::string& candidate : candidates)
+	{
+	  const auto diff = std::mismatch(common.begin(), common.end(), candidate.begin(), candidate.end());
+	  common = common.substr(0, static_cast<std::size_t>(diff.first - common.begin()));
+	}
+	if (common.size() <= word.size() || common.substr(0, word.size()) != word)
+	{
+	  return false;
+	}
+	insert(common.substr(word.size()));
+	if (candidates.size() == 1)
+	{
+	  insert(" ");
+	}
+	redraw(os, flush);
+	return true;
+      }
+
+      /** @brief True while a completion runs */
+      bool completing() const
+      {
+	std::lock_guard<std::mutex> lock(completion->mutex);
+	return completion->running || completion->ready;
+      }
+
+    private:
+      /** @brief Result slot shared with the completion thread, which may outlive the editor */
+      struct Completion
+      {
+	std::mutex mutex;
+	bool running = false;
+	bool ready = false;
+	// Generation of the line completed
+	std::uint64_t generation = 0;
+	std::vector<std::string> candidates;
+      };
+
+      std::string prompt;
+      History *history;
+      Completer complete;
+      std::string text;
+      // Byte offset of the cursor in text
+      std::size_t cursor = 0;
+      // Line displayed before browsing the history
+      std::string draft;
+      std::size_t browsing = 0;
+      bool searching = false;
+      std::string query;
+      std::size_t match = 0;
+      // Changes on each edit, to drop stale completions
+      std::uint64_t generation = 0;
+      std::shared_ptr<Completion> completion = std::make_shared<Completion>();
+      // What the terminal shows
+      std::string shownPrompt;
+      std::string shown;
+      std::size_t shownCursor = 0;
+      std::string out;
+
+      /** @brief Number of characters in bytes [from, to) of a string */
+      static std::size_t columns(std::string_view s, const std::size_t from, const std::size_t to)
+      {
+	std::size_t n = 0;
+	for (std::size_t i = from; i < to; ++i)
+	{
+	  n += (static_cast<unsigned char>(s[i]) & 0xC0) != 0x80 ? 1 : 0;
+	}
+	return n;
+      }
+
+      /** @brief Start of the character before byte i */
+      static std::size_t previous(std::string_view s, std::size_t i)
+      {
+	while (i > 0 && (static_cast<unsigned char>(s[--i]) & 0xC0) == 0x80)
+	{
+	}
+	return i;
+      }
+
+      std::size_t next(std::size_t i) const
+      {
+	if (i < text.size())
+	{
+	  ++i;
+	}
+	while (i < text.size() && (static_cast<unsigned char>(text[i]) & 0xC0) == 0x80)
+	{
+	  ++i;
+	}
+	return i;
+      }
+
+      std::size_t wordStart() const
+      {
+	std::size_t i = cursor;
+	while (i > 0 && text[i - 1] == ' ')
+	{
+	  --i;
+	}
+	while (i > 0 && text[i - 1] != ' ')
+	{
+	  --i;
+	}
+	return i;
+      }
+
+      void insert(std::string_view s)
+      {
+	text.insert(cursor, s);
+	cursor += s.size();
+	++generation;
+      }
+
+      void erase(const std::size_t from, const std::size_t to)
+      {
+	text.erase(from, to - from);
+	cursor = from;
+	++generation;
+      }
+
+      void edit(const KeyEvent& key, const bool ctrl)
+      {
+	if (key.code == Key::Left)
+	{
+	  cursor = previous(text, cursor);
+	}
+	else if (key.code == Key::Right)
+	{
+	  cursor = next(cursor);
+	}
+	else if (ctrl && key.code == Key::A)
+	{
+	  cursor = 0;
+	}
+	else if (ctrl && key.code == Key::E)
+	{
+	  cursor = text.size();
+	}
+	else if (key.code == Key::Backspace || (ctrl && key.code == Key::H))
+	{
+	  erase(previous(text, cursor), cursor);
+	}
+	else if (ctrl && key.code == Key::D)
+	{
+	  const std::size_t at = cursor;
+	  erase(at, next(at));
+	}
+	else if (ctrl && key.code == Key::K)
+	{
+	  erase(cursor, text.size());
+	}
+	else if (ctrl && key.code == Key::U)
+	{
+	  const std::size_t at = cursor;
+	  erase(0, at);
+	}
+	else if (ctrl && key.code == Key::W)
+	{
+	  const std::size_t at = cursor;
+	  erase(wordStart(), at);
+	}
+	else if (key.code == Key::Up || key.code == Key::Down)
+	{
+	  browse(key.code == Key::Up);
+	}
+	else if (ctrl && key.code == Key::R && history != nullptr)
+	{
+	  searching = true;
+	  query.clear();
+	  match = history->size();
+	}
+	else if (key.code == Key::Tab && complete)
+	{
+	  std::lock_guard<std::mutex> lock(completion->mutex);
+	  if (completion->running)
+	  {
+	    return;
+	  }
+	  completion->running = true;
+	  completion->ready = false;
+	  completion->generation = generation;
+	  std::thread([slot = completion, completer = complete, line = text, at = cursor]
+	  {
+	    std::vector<std::string> candidates = completer(line, at);
+	    std::lock_guard<std::mutex> lock(slot->mutex);
+	    slot->candidates = std::move(candidates);
+	    slot->running = false;
+	    slot->ready = true;
+	  }).detach();
+	}
+      }
+
+      void browse(const bool older)
+      {
+	if (history == nullptr || (older && browsing == 0) || (!older && browsing >= history->size()))
+	{
+	  return;
+	}
+	if (browsing == history->size())
+	{
+	  draft = text;
+	}
+	browsing += older ? -1 : 1;
+	text = browsing < history->size() ? std::string((*history)[browsing]) : draft;
+	cursor = text.size();
+	++generation;
+      }
+
+      /**
+       * @brief Handle a key in reverse search
+       * @return True if the search ends and the key is handled as usual
+       */
+      bool handleSearch(const KeyEvent& key, const bool ctrl)
+      {
+	if (ctrl && key.code == Key::R)
+	{
+	  find(match);
+	  return false;
+	}
+	if (key.code == Key::Backspace)
+	{
+	  query.erase(previous(query, query.size()));
+	  find(history->size());
+	  return false;
+	}
+	if (key.length != 0 && !ctrl)
+	{
+	  // The current match is the first candidate of the longer query
+	  query += key.text();
+	  find(std::min(match + 1, history->size()));
+	  return false;
+	}
+	searching = false;
+	if ((ctrl && key.code == Key::G) || key.code == Key::Escape)
+	{
+	  return false;
+	}
+	if (match < history->size())
+	{
+	  text = std::string((*history)[match]);
+	  cursor = text.size();
+	  ++generation;
+	}
+	return true;
+      }
+
+      void find(const std::size_t before)
+      {
+	const std::size_t found = history->search(query, before);
+	if (found < history->size())
+	{
+	  match = found;
+	}
+      }
+
+      /** @brief Move the terminal cursor along the line */
+      void moveTo(const std::size_t col)
+      {
+	if (col < shownCursor)
+	{
+	  out += "\x1b[";
+	  termUtils::appendNumber(out, shownCursor - col);
+	  out += 'D';
+	}
+	else if (col > shownCursor)
+	{
+	  out += "\x1b[";
+	  termUtils::appendNumber(out, col - shownCursor);
+	  out += 'C';
+	}
+	shownCursor = col;
+      }
+
+      /** @brief Show the line, rewriting it from the first changed character */
+      void redraw(std::ostream& os, const bool flush)
+      {
+	std::string_view line = text;
+	std::size_t at = cursor;
+	std::string searchPrompt;
+	if (searching)
+	{
+	  searchPrompt = "(reverse-i-search)`" + query + "': ";
+	  line = match < history->size() ? (*history)[match] : std::string_view();
+	  at = line.size();
+	}
+	const std::string& currentPrompt = searching ? searchPrompt : prompt;
+
+	out.clear();
+	const std::string_view clearEol = termUtils::sequence(capabilities().clearEol, "\x1b[K");
+	if (currentPrompt != shownPrompt)
+	{
+	  out += '\r';
+	  out += currentPrompt;
+	  out += line;
+	  out += clearEol;
+	  shownPrompt = currentPrompt;
+	  shownCursor = columns(line, 0, line.size());
+	}
+	else
+	{
+	  std::size_t common = static_cast<std::size_t>(
+	      std::mismatch(shown.begin(), shown.end(), line.begin(), line.end()).first - shown.begin());
+	  while (common > 0 && common < line.size() && (static_cast<unsigned char>(line[common]) & 0xC0) == 0x80)
+	  {
+	    --common;
+	  }
+	  if (common < shown.size() || common < line.size())
+	  {
+	    moveTo(columns(line, 0, common));
+	    out += line.substr(common);
+	    const std::size_t width = columns(shown, 0, shown.size());
+	    shownCursor = columns(line, 0, line.size());
+	    if (width > shownCursor)
+	    {
+	      out += clearEol;
+	    }
+	  }
+	}
+	shown = line;
+	moveTo(columns(line, 0, at));
+
+	os.write(out.data(), static_cast<std::streamsize>(out.size()));
+	if (flush)
+	{
+	  os << std::flush;
+	}
+      }
+  };
+
+}
+
+#endif
+
+#endif // LINEEDITOR_HPP
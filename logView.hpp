@@ -0,0 +1,297 @@
+#ifndef LOGVIEW_HPP
+#define LOGVIEW_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cell.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Log pane with a bounded scrollback
+   *
+   * Lines are stored in one byte arena used as a ring, with a ring of line
+   * references, so appending never allocates. The pane spans whole terminal
+   * rows and uses a scroll region: while following the end, each new line is
+   * drawn by scrolling the region, with a constant number of bytes. Lines can
+   * be appended from any thread.
+   */
+  class LogView
+  {
+    public:
+      using Clock = std::chrono::steady_clock;
+
+      /**
+       * @brief Create a log pane
+       *
+       * @param top first terminal row of the pane, from 0
+       * @param rows height of the pane
+       * @param cols width of the terminal
+       * @param maxLines number of lines kept in the scrollback
+       * @param maxBytes size of the text arena in bytes
+       */
+      LogView(const std::size_t top, const std::size_t rows, const std::size_t cols, const std::size_t maxLines =
+		  10000,
+	      const std::size_t maxBytes = 1024 * 1024)
+	  : top(top), height(rows), width(cols), arena(std::make_unique<char[]>(maxBytes)), capacity(maxBytes),
+	    refs(std::max<std::size_t>(maxLines, 1))
+      {
+      }
+
+      LogView(const LogView&) = delete;
+      LogView& operator=(const LogView&) = delete;
+
+      /**
+       * @brief Append a line, evicting the oldest ones when full
+       *
+       * @param text line without line feed, truncated to the arena size
+       */
+      void append(std::string_view text)
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	const std::size_t len = std::min(text.size(), capacity);
+	if (head + len > capacity)
+	{
+	  // Lines are contiguous: wrap to the start of the arena
+	  evict(head, capacity);
+	  head = 0;
+	}
+	evict(head, head + len);
+	if (count == refs.size())
+	{
+	  dropOldest();
+	}
+	std::memcpy(arena.get() + head, text.data(), len);
+	refs[(first + count) % refs.size()] = Ref { head, len };
+	++count;
+	head += len;
+	++total;
+	++pending;
+      }
+
+      /** @brief Number of lines in the scrollback */
+      std::size_t lines() const
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	return count;
+      }
+
+      /** @brief Number of lines appended since the creation */
+      std::size_t appended() const
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	return total;
+      }
+
+      /**
+       * @brief Scroll back from the end, 0 follows new lines
+       *
+       * @param offset number of lines above the last one
+       */
+      void scrollBack(const std::size_t offset)
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	back = offset;
+	repaint = true;
+      }
+
+      /** @brief Move or resize the pane */
+      void resize(const std::size_t row, const std::size_t rows, const std::size_t cols)
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	top = row;
+	height = rows;
+	width = cols;
+	repaint = true;
+      }
+
+      /** @brief Minimum time between two renders, later calls are skipped */
+      void setMinInterval(const Clock::duration interval)
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	minInterval = interval;
+      }
+
+      /** @brief True if render() has something to draw */
+      bool dirty() const
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	return repaint || (pending > 0 && back == 0);
+      }
+
+      /**
+       * @brief Draw the lines appended since last call
+       *
+       * When more lines than the pane height arrived, or the view is scrolled
+       * back, the pane is repainted from the newest lines instead.
+       *
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       * @return False if nothing was drawn, or if throttled
+       */
+      bool render(std::ostream& os = std::cout, const bool flush = true)
+      {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!repaint && (pending == 0 || back > 0))
+	{
+	  return false;
+	}
+	const Clock::time_point now = Clock::now();
+	if (now - lastRender < minInterval)
+	{
+	  return false;
+	}
+	lastRender = now;
+
+	out.clear();
+	termUtils::Emitter emitter(out);
+	emitter.style(Style());
+	// Set the scroll region, which homes the cursor
+	out += "\x1b[";
+	termUtils::appendNumber(out, top + 1);
+	out += ';';
+	termUtils::appendNumber(out, top + height);
+	out += 'r';
+	emitter.invalidate();
+
+	if (repaint || pending >= height || pending > count)
+	{
+	  // Show the newest rows, bottom aligned
+	  const std::size_t last = count > back ? count - back : 0;
+	  const std::size_t shown = std::min(last, height);
+	  for (std::size_t r = 0; r < height; ++r)
+	  {
+	    emitter.move(top + r, 0);
+	    const std::size_t cols = r >= height - shown ? appendLine(last - height + r) : 0;
+	    clearTail(cols);
+	  }
+	}
+	else
+	{
+	  // Scroll the region by one line per new line
+	  emitter.move(top + height - 1, 0);
+	  for (std::size_t i = count - pending; i < count; ++i)
+	  {
+	    out += "\r\n";
+	    clearTail(appendLine(i));
+	  }
+	}
+	pending = 0;
+	repaint = false;
+	// Restore the full screen scroll region
+	out += "\x1b[r";
+	lock.unlock();
+
+	os.write(out.data(), static_cast<std::streamsize>(out.size()));
+	if (flush)
+	{
+	  os << std::flush;
+	}
+	return true;
+      }
+
+    private:
+      struct Ref
+      {
+	  std::size_t offset = 0;
+	  std::size_t length = 0;
+      };
+
+      mutable std::mutex mutex;
+      std::size_t top;
+      std::size_t height;
+      std::size_t width;
+      std::unique_ptr<char[]> arena;
+      std::size_t capacity;
+      std::size_t head = 0;
+      std::vector<Ref> refs;
+      std::size_t first = 0;
+      std::size_t count = 0;
+      std::size_t total = 0;
+      std::size_t pending = 0;
+      std::size_t back = 0;
+      bool repaint = true;
+      Clock::duration minInterval = Clock::duration::zero();
+      Clock::time_point lastRender;
+      std::string out;
+
+      void dropOldest()
+      {
+	first = (first + 1) % refs.size();
+	--count;
+      }
+
+      /**
+       * @brief Drop the oldest lines overlapping a byte range of the arena
+       *
+       * Empty lines starting in the range are dropped too, else they would
+       * hide older lines behind them. A range reaching the end of the arena
+       * also takes the empty lines at the very end.
+       */
+      void evict(const std::size_t begin, const std::size_t end)
+      {
+	while (count > 0)
+	{
+	  const Ref& ref = refs[first];
+	  const bool overlaps = ref.offset < end && ref.offset + ref.length > begin;
+	  const bool inside = ref.offset >= begin && (ref.offset < end || end == capacity);
+	  if (!overlaps && !inside)
+	  {
+	    break;
+	  }
+	  dropOldest();
+	}
+      }
+
+      /**
+       * @brief Append a scrollback line clipped to the pane width
+       * @return Number of columns written
+       */
+      std::size_t appendLine(const std::size_t n)
+      {
+	const Ref& ref = refs[(first + n) % refs.size()];
+	std::string_view text(arena.get() + ref.offset, ref.length);
+	std::size_t i = 0;
+	std::size_t cols = 0;
+	while (i < text.size() && cols < width)
+	{
+	  const std::size_t start = i;
+	  const char32_t cp = termUtils::decodeUtf8(text, i);
+	  if (cp < 0x20 || cp == 0x7F)
+	  {
+	    out += ' ';
+	  }
+	  else
+	  {
+	    out.append(text.data() + start, i - start);
+	  }
+	  ++cols;
+	}
+	return cols;
+      }
+
+      /**
+       * @brief Clear the rest of a line of some columns. After a full width
+       * line the cursor waits on the last column, which EL would erase
+       */
+      void clearTail(const std::size_t cols)
+      {
+	if (cols < width)
+	{
+	  out += clear::LINE_TO_RIGHT;
+	}
+      }
+  };
+
+}
+
+#endif // LOGVIEW_HPP
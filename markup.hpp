@@ -0,0 +1,467 @@
+#ifndef MARKUP_HPP
+#define MARKUP_HPP
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+#ifdef __cpp_lib_format
+#include <format>
+#include <iterator>
+#endif
+
+namespace termUtils
+{
+
+/** @brief String literal usable as a template argument */
+template <std::size_t N>
+struct FixedString {
+    char value[N] {};
+
+    constexpr FixedString(const char (&text)[N])
+    {
+        std::copy_n(text, N, value);
+    }
+
+    constexpr std::string_view view() const
+    {
+        return std::string_view(value, N - 1);
+    }
+};
+
+/** @brief Output of the markup compiler: counts when no storage is given */
+struct MarkupSink {
+    char* bytes = nullptr;
+    std::size_t* ends = nullptr;
+    std::size_t size = 0;
+    std::size_t args = 0;
+
+    constexpr void put(const std::string_view text)
+    {
+        for(const char c : text) {
+            if(bytes != nullptr) {
+                bytes[size] = c;
+            }
+            ++size;
+        }
+    }
+
+    /** @brief An argument comes here, ending the current literal segment */
+    constexpr void arg()
+    {
+        if(ends != nullptr) {
+            ends[args] = size;
+        }
+        ++args;
+    }
+};
+
+/** @brief SGR parameters of one style group, e.g. "31;1" */
+struct MarkupParams {
+    char text[48] {};
+    std::size_t size = 0;
+
+    constexpr void add(const std::string_view param)
+    {
+        if(size + param.size() + 1 > sizeof(text)) {
+            throw std::length_error("markup: too many attributes in a style group");
+        }
+        if(size != 0) {
+            text[size++] = ';';
+        }
+        for(const char c : param) {
+            text[size++] = c;
+        }
+    }
+
+    constexpr void add(unsigned value)
+    {
+        char digits[3] {};
+        std::size_t n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while(value != 0);
+        char param[3] {};
+        for(std::size_t i = 0; i < n; ++i) {
+            param[i] = digits[n - 1 - i];
+        }
+        add(std::string_view(param, n));
+    }
+
+    constexpr std::string_view view() const
+    {
+        return std::string_view(text, size);
+    }
+};
+
+/** @brief Position of a character. GCC 12 rejects string_view::find() on template arguments */
+constexpr std::size_t markupFind(const std::string_view text, const char c, std::size_t from)
+{
+    for(; from < text.size(); ++from) {
+        if(text[from] == c) {
+            return from;
+        }
+    }
+    return std::string_view::npos;
+}
+
+constexpr unsigned markupNumber(const std::string_view text, const unsigned max)
+{
+    if(text.empty() || text.size() > 3) {
+        throw std::invalid_argument("markup: invalid color number");
+    }
+    unsigned value = 0;
+    for(const char c : text) {
+        if(c < '0' || c > '9') {
+            throw std::invalid_argument("markup: invalid color number");
+        }
+        value = value * 10 + static_cast<unsigned>(c - '0');
+    }
+    if(value > max) {
+        throw std::out_of_range("markup: color number out of range");
+    }
+    return value;
+}
+
+constexpr unsigned markupHex(const char c)
+{
+    if(c >= '0' && c <= '9') {
+        return static_cast<unsigned>(c - '0');
+    }
+    if(c >= 'a' && c <= 'f') {
+        return static_cast<unsigned>(c - 'a' + 10);
+    }
+    if(c >= 'A' && c <= 'F') {
+        return static_cast<unsigned>(c - 'A' + 10);
+    }
+    throw std::invalid_argument("markup: invalid hex color");
+}
+
+/** @brief Parameters of fg:color or bg:color */
+constexpr void markupColor(const std::string_view name, const bool background, MarkupParams& params)
+{
+    constexpr std::string_view NAMES[] = { "black", "red", "green", "yellow", "blue", "magenta", "cyan", "white" };
+    const unsigned base = background ? 40 : 30;
+    for(unsigned i = 0; i < 8; ++i) {
+        if(name == NAMES[i]) {
+            params.add(base + i);
+            return;
+        }
+    }
+    if(name == "default") {
+        params.add(base + 9);
+    } else if(!name.empty() && name[0] == '#') {
+        if(name.size() != 7) {
+            throw std::invalid_argument("markup: hex color needs 6 digits");
+        }
+        params.add(base + 8);
+        params.add(2);
+        for(std::size_t i = 1; i < 7; i += 2) {
+            params.add(markupHex(name[i]) * 16 + markupHex(name[i + 1]));
+        }
+    } else if(!name.empty() && name[0] >= '0' && name[0] <= '9') {
+        params.add(base + 8);
+        params.add(5);
+        params.add(markupNumber(name, 255));
+    } else {
+        throw std::invalid_argument("markup: unknown color");
+    }
+}
+
+/**
+ * @brief Compile markup into escape bytes and argument positions
+ *
+ * Syntax: {} is an argument, {tag,tag} opens a style group and {/} closes
+ * the last one, {{ and }} are braces. Tags are fg:color, bg:color, bold,
+ * dim, underline, blink and reverse, colors are names, 0 to 255 or #rrggbb.
+ * Closing a group resets the attributes and restores the enclosing groups.
+ * Errors throw, which fails the build when compiled as a constant.
+ */
+constexpr void compileMarkup(const std::string_view markup, MarkupSink& sink)
+{
+    constexpr std::size_t DEPTH = 8;
+    MarkupParams stack[DEPTH] {};
+    std::size_t depth = 0;
+
+    std::size_t i = 0;
+    while(i < markup.size()) {
+        const char c = markup[i];
+        if(c == '}') {
+            if(i + 1 >= markup.size() || markup[i + 1] != '}') {
+                throw std::invalid_argument("markup: unmatched }");
+            }
+            sink.put("}");
+            i += 2;
+            continue;
+        }
+        if(c != '{') {
+            sink.put(markup.substr(i, 1));
+            ++i;
+            continue;
+        }
+        if(i + 1 < markup.size() && markup[i + 1] == '{') {
+            sink.put("{");
+            i += 2;
+            continue;
+        }
+
+        const std::size_t close = markupFind(markup, '}', i);
+        if(close == std::string_view::npos) {
+            throw std::invalid_argument("markup: unterminated {");
+        }
+        const std::string_view body = markup.substr(i + 1, close - i - 1);
+        i = close + 1;
+
+        if(body.empty()) {
+            sink.arg();
+        } else if(body == "/") {
+            if(depth == 0) {
+                throw std::invalid_argument("markup: {/} without open style");
+            }
+            --depth;
+            sink.put("\x1b[0");
+            for(std::size_t d = 0; d < depth; ++d) {
+                sink.put(";");
+                sink.put(stack[d].view());
+            }
+            sink.put("m");
+        } else {
+            if(depth == DEPTH) {
+                throw std::length_error("markup: styles nested too deep");
+            }
+            MarkupParams& params = stack[depth++];
+            params = MarkupParams();
+            std::size_t start = 0;
+            while(start <= body.size()) {
+                const std::size_t end = std::min(markupFind(body, ',', start), body.size());
+                const std::string_view tag = body.substr(start, end - start);
+                if(tag.substr(0, 3) == "fg:") {
+                    markupColor(tag.substr(3), false, params);
+                } else if(tag.substr(0, 3) == "bg:") {
+                    markupColor(tag.substr(3), true, params);
+                } else if(tag == "bold" || tag == "bright") {
+                    params.add(1);
+                } else if(tag == "dim") {
+                    params.add(2);
+                } else if(tag == "underline" || tag == "underscore") {
+                    params.add(4);
+                } else if(tag == "blink") {
+                    params.add(5);
+                } else if(tag == "reverse") {
+                    params.add(7);
+                } else {
+                    throw std::invalid_argument("markup: unknown tag");
+                }
+                start = end + 1;
+            }
+            sink.put("\x1b[");
+            sink.put(params.view());
+            sink.put("m");
+        }
+    }
+    if(depth != 0) {
+        throw std::invalid_argument("markup: style left open, missing {/}");
+    }
+}
+
+/** @brief Escape bytes of a markup, and where its arguments go */
+template <std::size_t BYTES, std::size_t ARGS>
+struct CompiledMarkup {
+    std::array<char, BYTES + 1> bytes {};
+    // End of the literal segment before each argument
+    std::array<std::size_t, ARGS + 1> ends {};
+};
+
+template <FixedString MARKUP>
+struct Markup {
+    static constexpr MarkupSink SIZES = [] {
+        MarkupSink sink;
+        compileMarkup(MARKUP.view(), sink);
+        return sink;
+    }();
+
+    static constexpr std::size_t ARGS = SIZES.args;
+
+    static constexpr CompiledMarkup<SIZES.size, SIZES.args> DATA = [] {
+        CompiledMarkup<SIZES.size, SIZES.args> data;
+        MarkupSink sink { data.bytes.data(), data.ends.data() };
+        compileMarkup(MARKUP.view(), sink);
+        data.ends[ARGS] = sink.size;
+        return data;
+    }();
+
+    static constexpr std::string_view segment(const std::size_t n)
+    {
+        const std::size_t start = n == 0 ? 0 : DATA.ends[n - 1];
+        return std::string_view(DATA.bytes.data() + start, DATA.ends[n] - start);
+    }
+};
+
+/** @brief Append an argument of styled text */
+template <typename T>
+void appendArg(std::string& out, const T& value)
+{
+#ifdef __cpp_lib_format
+    if constexpr(std::is_convertible_v<const T&, std::string_view>) {
+        out += std::string_view(value);
+    } else {
+        std::format_to(std::back_inserter(out), "{}", value);
+    }
+#else
+    if constexpr(std::is_convertible_v<const T&, std::string_view>) {
+        out += std::string_view(value);
+    } else if constexpr(std::is_same_v<T, char>) {
+        out += value;
+    } else if constexpr(std::is_same_v<T, bool>) {
+        out += value ? "true" : "false";
+    } else if constexpr(std::is_arithmetic_v<T>) {
+        char buf[64];
+        const auto res = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, res.ptr);
+    } else {
+        static_assert(std::is_arithmetic_v<T>, "markup: argument type needs <format>");
+    }
+#endif
+}
+
+template <FixedString MARKUP, std::size_t... I, typename... Args>
+void appendMarkup(std::string& out, std::index_sequence<I...>, const Args&... args)
+{
+    using M = Markup<MARKUP>;
+    ((out += M::segment(I), appendArg(out, args)), ...);
+    out += M::segment(M::ARGS);
+}
+
+};
+
+namespace term
+{
+
+  /**
+   * @brief Append text styled by a markup parsed at compile time
+   *
+   * Example: styled<"{fg:red,bold}error:{/} {}">(out, message). The markup is
+   * validated when compiled, see termUtils::compileMarkup(); at runtime only
+   * the arguments are formatted, with std::format when available.
+   *
+   * @param out output buffer
+   * @param args one argument per {}
+   */
+  template <termUtils::FixedString MARKUP, typename... Args>
+  void styled(std::string& out, const Args&... args)
+  {
+    static_assert(sizeof...(Args) == termUtils::Markup<MARKUP>::ARGS, "markup: wrong number of arguments");
+    termUtils::appendMarkup<MARKUP>(out, std::index_sequence_for<Args...>(), args...);
+  }
+
+  /**
+   * @brief Write text styled by a markup parsed at compile time
+   *
+   * Uses a buffer reused by the thread, the output is written at once.
+   *
+   * @param os output
+   * @param args one argument per {}
+   */
+  template <termUtils::FixedString MARKUP, typename... Args>
+  void printStyled(std::ostream& os, const Args&... args)
+  {
+    static thread_local std::string out;
+    out.clear();
+    styled<MARKUP>(out, args...);
+    os.write(out.data(), static_cast<std::streamsize>(out.size()));
+  }
+
+  /**
+   * @brief Text styled by a markup, for std::format or an ostream, see
+   * styledText()
+   *
+   * Keeps references to the arguments: use it within the expression
+   * creating it.
+   */
+  template <termUtils::FixedString MARKUP, typename... Args>
+  class StyledText
+  {
+    public:
+      explicit StyledText(const Args&... args)
+	  : args(args...)
+      {
+      }
+
+      /** @brief Append the styled text, like styled() */
+      void appendTo(std::string& out) const
+      {
+	std::apply([&out](const Args&... values)
+	{
+	  termUtils::appendMarkup<MARKUP>(out, std::index_sequence_for<Args...>(), values...);
+	}, args);
+      }
+
+      friend std::ostream& operator <<(std::ostream& os, const StyledText& text)
+      {
+	static thread_local std::string out;
+	out.clear();
+	text.appendTo(out);
+	return os.write(out.data(), static_cast<std::streamsize>(out.size()));
+      }
+
+    private:
+      std::tuple<const Args&...> args;
+  };
+
+  /**
+   * @brief Text styled by a markup parsed at compile time, as a value
+   *
+   * Example: std::format("{} done", styledText<"{fg:green}{}{/}">(name)),
+   * or std::cout << styledText<"{bold}{}{/}">(count).
+   *
+   * @param args one argument per {}
+   */
+  template <termUtils::FixedString MARKUP, typename... Args>
+  StyledText<MARKUP, Args...> styledText(const Args&... args)
+  {
+    static_assert(sizeof...(Args) == termUtils::Markup<MARKUP>::ARGS, "markup: wrong number of arguments");
+    return StyledText<MARKUP, Args...>(args...);
+  }
+
+}
+
+#ifdef __cpp_lib_format
+namespace std
+{
+
+/** @brief Formats term::StyledText with "{}", no format spec */
+template <termUtils::FixedString MARKUP, typename... Args>
+struct formatter<term::StyledText<MARKUP, Args...>, char> {
+    constexpr auto parse(format_parse_context& ctx)
+    {
+        if(ctx.begin() != ctx.end() && *ctx.begin() != '}') {
+            throw format_error("styled text takes no format spec");
+        }
+        return ctx.begin();
+    }
+
+    template <typename Context>
+    auto format(const term::StyledText<MARKUP, Args...>& text, Context& ctx) const
+    {
+        std::string out;
+        text.appendTo(out);
+        return std::copy(out.begin(), out.end(), ctx.out());
+    }
+};
+
+}
+#endif
+
+#endif // MARKUP_HPP
@@ -0,0 +1,333 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "capabilities.hpp"
+#include "cell.hpp"
+#include "frameDiff.hpp"
+#include "trace.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Non blocking frame output to a terminal
+   *
+   * The bytes of a frame are queued, then written through a non blocking
+   * descriptor as fast as the terminal reads them. A frame submitted while
+   * another one is still being written waits; a newer frame replaces it, so
+   * only the latest frame is drawn once the terminal catches up. Frames are
+   * drawn as a diff against the cells the terminal received, and the bytes
+   * of a started frame are never dropped.
+   *
+   * Not thread safe. Call flush() when the descriptor is writable, see
+   * pending().
+   */
+  class Output
+  {
+    public:
+      /**
+       * @brief Create an output to the terminal of stdout
+       *
+       * The terminal is opened again, so the non blocking mode does not
+       * reach stdin, std::cout or other users of the same open file. If
+       * stdout is not a terminal it is written to in blocking mode.
+       *
+       * @param caps features of the terminal, outliving the output. Default
+       * is the library profile
+       */
+      explicit Output(const Capabilities& caps = capabilities())
+	  : fd(-1), caps(caps)
+      {
+	const char *name = ttyname(STDOUT_FILENO);
+	if (name != nullptr)
+	{
+	  fd = ::open(name, O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+	}
+	owned = fd >= 0;
+	if (!owned)
+	{
+	  fd = STDOUT_FILENO;
+	}
+      }
+
+      /**
+       * @brief Create an output to a descriptor, switched to non blocking
+       * mode
+       *
+       * The mode belongs to the open file, so it also applies to the
+       * descriptors sharing it, e.g. stdin and stdout of the same tty:
+       * pass a descriptor dedicated to the output.
+       *
+       * @param fd descriptor, outliving the output
+       * @param caps features of the terminal, outliving the output. Default
+       * is the library profile
+       */
+      explicit Output(const int fd, const Capabilities& caps = capabilities())
+	  : fd(fd), caps(caps)
+      {
+	flags = fcntl(fd, F_GETFL);
+	if (flags >= 0)
+	{
+	  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+	}
+      }
+
+      /** @brief Restore the blocking mode or close the terminal. Queued bytes are lost */
+      ~Output()
+      {
+	if (owned)
+	{
+	  ::close(fd);
+	}
+	else if (flags >= 0)
+	{
+	  fcntl(fd, F_SETFL, flags);
+	}
+      }
+
+      Output(const Output&) = delete;
+      Output& operator=(const Output&) = delete;
+
+      /** @brief Redraw the whole screen on next frame */
+      void invalidate()
+      {
+	redraw = true;
+      }
+
+      /**
+       * @brief Find the changed rows of big frames on the threads of a pool,
+       * see FrameDiff
+       *
+       * @param pool threads outliving the output, nullptr for none
+       */
+      void setWorkPool(WorkPool *pool)
+      {
+	diff.setPool(pool);
+      }
+
+      /**
+       * @brief Submit a frame
+       *
+       * The frame is drawn at once if nothing is queued, otherwise it is
+       * kept until the queue drains, replacing any frame kept before.
+       *
+       * @param frame cells to display
+       * @return False on a write error
+       */
+      bool submit(const CellBuffer& frame)
+      {
+	if (!queue.empty())
+	{
+	  if (waiting)
+	  {
+	    ++dropped;
+	  }
+	  latest = frame;
+	  waiting = true;
+	  return true;
+	}
+	render(frame);
+	return flush();
+      }
+
+      /**
+       * @brief Queue bytes which do not change the cells, e.g. queries or
+       * mode changes, and write what can be
+       *
+       * @return False on a write error
+       */
+      bool append(const std::string_view bytes)
+      {
+	queue += bytes;
+	return flush();
+      }
+
+      /**
+       * @brief Write queued bytes without blocking
+       *
+       * Starts the waiting frame once the queue is empty.
+       *
+       * @return False on a write error
+       */
+      bool flush()
+      {
+	while (true)
+	{
+	  if (offset < queue.size())
+	  {
+	    // Traced only when bytes are written, and closed before the next
+	    // frame is built
+#ifdef TERM_ENABLE_TRACE
+	    TraceScope trace(TraceStage::Write);
+#endif
+	    while (offset < queue.size())
+	    {
+	      const ssize_t n = ::write(fd, queue.data() + offset, queue.size() - offset);
+	      if (n < 0)
+	      {
+		if (errno == EINTR)
+		{
+		  continue;
+		}
+#ifdef TERM_ENABLE_TRACE
+		// The keys are answered by the write draining the queue
+		trace.unfinished();
+#endif
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+	      }
+	      offset += static_cast<std::size_t>(n);
+	    }
+	  }
+	  queue.clear();
+	  offset = 0;
+	  if (!waiting)
+	  {
+	    return true;
+	  }
+	  waiting = false;
+	  render(latest);
+	}
+      }
+
+      /**
+       * @brief Wait until all frames are written
+       *
+       * @param timeout maximum time to wait
+       * @return True if nothing is left to write
+       */
+      bool drain(const std::chrono::milliseconds timeout)
+      {
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (flush() && pending())
+	{
+	  const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+	  if (left.count() <= 0)
+	  {
+	    return false;
+	  }
+	  pollfd pfd = { fd, POLLOUT, 0 };
+	  poll(&pfd, 1, static_cast<int>(left.count()));
+	}
+	return !pending();
+      }
+
+      /** @brief True while bytes are queued: wait for POLLOUT then call flush() */
+      bool pending() const
+      {
+	return offset < queue.size() || waiting;
+      }
+
+      /** @brief File descriptor written to */
+      int descriptor() const
+      {
+	return fd;
+      }
+
+      /** @brief Bytes queued but not written yet */
+      std::size_t queued() const
+      {
+	return queue.size() - offset;
+      }
+
+      /** @brief Frames drawn */
+      std::size_t framesSent() const
+      {
+	return sent;
+      }
+
+      /** @brief Frames replaced by a newer one before being drawn */
+      std::size_t framesDropped() const
+      {
+	return dropped;
+      }
+
+    private:
+      int fd;
+      const Capabilities& caps;
+      // Blocking mode to restore, -1 if unchanged
+      int flags = -1;
+      // Descriptor opened by the output
+      bool owned = false;
+      // Cells the terminal has once the queue is written
+      CellBuffer terminal;
+      CellBuffer latest;
+      FrameDiff diff;
+      std::string queue;
+      std::size_t offset = 0;
+      bool waiting = false;
+      bool redraw = true;
+      std::size_t sent = 0;
+      std::size_t dropped = 0;
+
+      /** @brief Queue the bytes changing the terminal cells to a frame */
+      void render(const CellBuffer& frame)
+      {
+	TERM_TRACE_SCOPE(Build);
+	const Rect all { 0, 0, frame.rows(), frame.cols() };
+	if (frame.rows() != terminal.rows() || frame.cols() != terminal.cols())
+	{
+	  terminal.resize(frame.size());
+	  redraw = true;
+	}
+
+	const bool sync = caps.synchronizedOutput;
+	if (sync)
+	{
+	  queue += "\x1b[?2026h";
+	}
+	const std::size_t start = queue.size();
+	termUtils::Emitter emitter(queue, caps);
+	const bool full = redraw;
+	if (full)
+	{
+	  queue += "\x1b[0m\x1b[2J";
+	  emitter.full(frame, all);
+	  redraw = false;
+	}
+	else
+	{
+	  diff.draw(emitter, terminal, frame, all);
+	}
+	if (queue.size() > start)
+	{
+	  emitter.reset();
+	}
+	if (sync)
+	{
+	  if (queue.size() == start)
+	  {
+	    queue.resize(start - 8);
+	  }
+	  else
+	  {
+	    queue += "\x1b[?2026l";
+	  }
+	}
+	if (full)
+	{
+	  terminal.blit(frame, all, 0, 0);
+	}
+	else
+	{
+	  diff.update(terminal, frame);
+	}
+	++sent;
+      }
+  };
+
+}
+
+#endif
+
+#endif // OUTPUT_HPP
@@ -0,0 +1,398 @@
+#ifndef PAGER_HPP
+#define PAGER_HPP
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cell.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Read only view of a large file
+   *
+   * The file is memory mapped and its line offsets are indexed by a
+   * background thread, chunk by chunk, while the first lines are already
+   * available. Only the visible lines are read when rendering.
+   */
+  class Pager
+  {
+    public:
+      Pager()
+      {
+      }
+
+      Pager(const Pager&) = delete;
+      Pager& operator=(const Pager&) = delete;
+
+      ~Pager()
+      {
+	close();
+      }
+
+      /**
+       * @brief Map a file and start indexing it
+       *
+       * @param path file to open
+       * @return False if the file cannot be opened or mapped
+       */
+      bool open(const std::string& path)
+      {
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+	  return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+	  ::close(fd);
+	  return false;
+	}
+	length = static_cast<std::size_t>(st.st_size);
+	if (length > 0)
+	{
+	  void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	  if (addr == MAP_FAILED)
+	  {
+	    ::close(fd);
+	    length = 0;
+	    return false;
+	  }
+	  data = static_cast<const char*>(addr);
+	  madvise(addr, length, MADV_SEQUENTIAL);
+	}
+	::close(fd);
+
+	// A file of n bytes has at most n + 1 lines: the block table never grows
+	blockCount = (length + 1) / BLOCK_SIZE + 1;
+	blocks = std::make_unique<std::unique_ptr<std::uint64_t[]>[]>(blockCount);
+	append(0);
+	scanned = 0;
+	done = false;
+	stopping = false;
+	top = 0;
+	left = 0;
+
+	// Index the first screen synchronously so it shows at once
+	scan(std::min(length, FIRST_CHUNK));
+	if (scanned < length)
+	{
+	  indexer = std::thread(&Pager::run, this);
+	}
+	else
+	{
+	  finish();
+	}
+	return true;
+      }
+
+      /** @brief Stop indexing and unmap the file */
+      void close()
+      {
+	stopping = true;
+	if (indexer.joinable())
+	{
+	  indexer.join();
+	}
+	if (data != nullptr)
+	{
+	  munmap(const_cast<char*>(data), length);
+	  data = nullptr;
+	}
+	blocks.reset();
+	count = 0;
+	length = 0;
+      }
+
+      /** @brief Size of the file in bytes */
+      std::size_t size() const
+      {
+	return length;
+      }
+
+      /** @brief Number of lines indexed so far */
+      std::size_t lines() const
+      {
+	const std::size_t n = count.load(std::memory_order_acquire);
+	if (n == 0)
+	{
+	  return 0;
+	}
+	// The last line is only known once indexing is over, and is only a line
+	// when text follows the last line feed
+	if (!done.load(std::memory_order_acquire) || offset(n - 1) == length)
+	{
+	  return n - 1;
+	}
+	return n;
+      }
+
+      /** @brief True once the whole file is indexed */
+      bool indexed() const
+      {
+	return done.load(std::memory_order_acquire);
+      }
+
+      /** @brief Wait until a line is indexed or the file is fully indexed */
+      void waitFor(const std::size_t line)
+      {
+	std::unique_lock<std::mutex> lock(mutex);
+	cv.wait(lock, [this, line]
+	{
+	  return lines() > line || indexed();
+	});
+      }
+
+      /**
+       * @brief Text of a line without its line feed
+       *
+       * @param n line number, from 0, lower than lines()
+       */
+      std::string_view line(const std::size_t n) const
+      {
+	const std::size_t begin = offset(n);
+	std::size_t end = n + 1 < count.load(std::memory_order_acquire) ? offset(n + 1) - 1 : length;
+	if (end > begin && data[end - 1] == '\r')
+	{
+	  --end;
+	}
+	return std::string_view(data + begin, end - begin);
+      }
+
+      /**
+       * @brief Line containing a byte offset, in O(log n) on indexed lines
+       *
+       * @param pos byte offset in the file
+       */
+      std::size_t lineAt(const std::size_t pos) const
+      {
+	std::size_t lo = 0;
+	std::size_t hi = count.load(std::memory_order_acquire);
+	while (hi - lo > 1)
+	{
+	  const std::size_t mid = lo + (hi - lo) / 2;
+	  if (offset(mid) <= pos)
+	  {
+	    lo = mid;
+	  }
+	  else
+	  {
+	    hi = mid;
+	  }
+	}
+	return lo;
+      }
+
+      /** @brief First visible line */
+      std::size_t position() const
+      {
+	return top;
+      }
+
+      /** @brief Show a line at the top, clamped to the indexed lines */
+      void scrollTo(const std::size_t line)
+      {
+	const std::size_t n = lines();
+	top = n == 0 ? 0 : std::min(line, n - 1);
+      }
+
+      /** @brief Scroll by a number of lines, negative goes up */
+      void scroll(const long delta)
+      {
+	if (delta < 0)
+	{
+	  const std::size_t up = static_cast<std::size_t>(-delta);
+	  scrollTo(top > up ? top - up : 0);
+	}
+	else
+	{
+	  scrollTo(top + static_cast<std::size_t>(delta));
+	}
+      }
+
+      /** @brief Scroll horizontally to show lines from a column */
+      void scrollToCol(const std::size_t col)
+      {
+	left = col;
+      }
+
+      /**
+       * @brief Draw the visible lines
+       *
+       * @param view screen area of the pager
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       */
+      void render(const Rect& view, std::ostream& os = std::cout, const bool flush = true)
+      {
+	out.clear();
+	termUtils::Emitter emitter(out);
+	emitter.style(Style());
+	const std::size_t n = lines();
+	for (std::size_t r = 0; r < view.rows; ++r)
+	{
+	  emitter.move(view.row + r, view.col);
+	  std::size_t cols = 0;
+	  if (top + r < n)
+	  {
+	    cols = renderLine(line(top + r), view.cols);
+	  }
+	  out.append(view.cols - cols, ' ');
+	}
+	os.write(out.data(), static_cast<std::streamsize>(out.size()));
+	if (flush)
+	{
+	  os << std::flush;
+	}
+      }
+
+    private:
+      static constexpr std::size_t BLOCK_BITS = 16;
+      static constexpr std::size_t BLOCK_SIZE = std::size_t(1) << BLOCK_BITS;
+      /** @brief Bytes indexed before open() returns */
+      static constexpr std::size_t FIRST_CHUNK = 64 * 1024;
+      /** @brief Bytes indexed between two publications */
+      static constexpr std::size_t CHUNK = 4 * 1024 * 1024;
+      static constexpr std::size_t TAB_SIZE = 8;
+
+      const char *data = nullptr;
+      std::size_t length = 0;
+      // Line start offsets in fixed blocks so readers never see a reallocation
+      std::unique_ptr<std::unique_ptr<std::uint64_t[]>[]> blocks;
+      std::size_t blockCount = 0;
+      std::atomic<std::size_t> count { 0 };
+      std::size_t scanned = 0;
+      std::atomic<bool> done { false };
+      std::atomic<bool> stopping { false };
+      std::thread indexer;
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::size_t top = 0;
+      std::size_t left = 0;
+      std::string out;
+
+      std::size_t offset(const std::size_t n) const
+      {
+	return blocks[n >> BLOCK_BITS][n & (BLOCK_SIZE - 1)];
+      }
+
+      /** @brief Store a line start. Only called by the indexing thread */
+      void append(const std::size_t pos)
+      {
+	const std::size_t n = count.load(std::memory_order_relaxed);
+	std::unique_ptr<std::uint64_t[]>& block = blocks[n >> BLOCK_BITS];
+	if (!block)
+	{
+	  block = std::make_unique<std::uint64_t[]>(BLOCK_SIZE);
+	}
+	block[n & (BLOCK_SIZE - 1)] = pos;
+	count.store(n + 1, std::memory_order_release);
+      }
+
+      /** @brief Index line feeds up to a byte offset */
+      void scan(const std::size_t end)
+      {
+	const char *p = data + scanned;
+	const char *last = data + end;
+	while (p < last)
+	{
+	  // memchr is vectorized by the C library
+	  const char *nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(last - p)));
+	  if (nl == nullptr)
+	  {
+	    break;
+	  }
+	  append(static_cast<std::size_t>(nl - data) + 1);
+	  p = nl + 1;
+	}
+	scanned = end;
+      }
+
+      void finish()
+      {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  done.store(true, std::memory_order_release);
+	}
+	cv.notify_all();
+      }
+
+      void run()
+      {
+	while (scanned < length && !stopping.load(std::memory_order_relaxed))
+	{
+	  scan(std::min(length, scanned + CHUNK));
+	  {
+	    std::lock_guard<std::mutex> lock(mutex);
+	  }
+	  cv.notify_all();
+	}
+	if (scanned == length)
+	{
+	  finish();
+	}
+      }
+
+      /** @brief Append a line clipped to a width, return the columns used */
+      std::size_t renderLine(std::string_view text, const std::size_t width)
+      {
+	std::size_t col = 0;
+	std::size_t i = 0;
+	while (i < text.size() && col < left + width)
+	{
+	  const std::size_t start = i;
+	  const char32_t cp = termUtils::decodeUtf8(text, i);
+	  std::size_t cells = 1;
+	  if (cp == U'\t')
+	  {
+	    cells = TAB_SIZE - col % TAB_SIZE;
+	  }
+	  for (std::size_t k = 0; k < cells && col < left + width; ++k, ++col)
+	  {
+	    if (col < left)
+	    {
+	      continue;
+	    }
+	    if (cp == U'\t' || cp < 0x20 || cp == 0x7F)
+	    {
+	      out += ' ';
+	    }
+	    else if (cp == termUtils::REPLACEMENT)
+	    {
+	      termUtils::appendUtf8(out, cp);
+	    }
+	    else
+	    {
+	      out.append(text.data() + start, i - start);
+	    }
+	  }
+	}
+	return col > left ? col - left : 0;
+      }
+  };
+
+}
+
+#endif
+
+#endif // PAGER_HPP
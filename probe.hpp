@@ -0,0 +1,329 @@
+#ifndef PROBE_HPP
+#define PROBE_HPP
+
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#include "capabilities.hpp"
+#include "term.hpp"
+
+namespace termUtils
+{
+
+/**
+ * @brief Queries sent by a probe, in one write
+ *
+ * Every terminal answers primary device attributes, so DA1 comes last: its
+ * reply means all the replies the terminal will send have arrived.
+ */
+constexpr std::string_view PROBE_QUERIES(
+    "\x1b[>0q"                          // XTVERSION
+    "\x1b[>c"                           // DA2
+    "\x1b[?2026$p"                      // DECRQM synchronized output
+    "\x1b[?2004$p"                      // DECRQM bracketed paste
+    "\x1b[?1006$p"                      // DECRQM SGR mouse
+    "\x1b]10;?\x1b\\"                   // default foreground
+    "\x1b]11;?\x1b\\"                   // default background
+    "\x1b[6n"                           // cursor position
+    "\x1b[c");                          // DA1, sentinel
+
+/** @brief Numbers separated by ';', other characters are skipped */
+inline std::vector<int> probeNumbers(std::string_view params)
+{
+    std::vector<int> numbers;
+    std::size_t i = 0;
+    while(i < params.size()) {
+        if(params[i] < '0' || params[i] > '9') {
+            ++i;
+            continue;
+        }
+        int v = 0;
+        const auto res = std::from_chars(params.data() + i, params.data() + params.size(), v);
+        numbers.push_back(v);
+        i = static_cast<std::size_t>(res.ptr - params.data());
+    }
+    return numbers;
+}
+
+/**
+ * @brief Color of an OSC 10/11 reply, "rgb:RRRR/GGGG/BBBB" with 1 to 4 hex
+ * digits per component
+ * @return 0xRRGGBB, -1 if malformed
+ */
+inline long probeColor(std::string_view spec)
+{
+    if(spec.substr(0, 4) != "rgb:") {
+        return -1;
+    }
+    spec.remove_prefix(4);
+    long rgb = 0;
+    for(int component = 0; component < 3; ++component) {
+        const std::size_t end = std::min(spec.find('/'), spec.size());
+        if(end == 0 || end > 4) {
+            return -1;
+        }
+        unsigned v = 0;
+        const auto res = std::from_chars(spec.data(), spec.data() + end, v, 16);
+        if(res.ptr != spec.data() + end) {
+            return -1;
+        }
+        const unsigned max = (1u << (4 * end)) - 1;
+        rgb = rgb << 8 | static_cast<long>((v * 255 + max / 2) / max);
+        spec.remove_prefix(std::min(end + 1, spec.size()));
+    }
+    return rgb;
+}
+
+/**
+ * @brief Parse the replies to PROBE_QUERIES
+ *
+ * Can be called again on the same data as more arrives. Bytes which are not
+ * replies, keys typed meanwhile, are added to unread. An incomplete sequence
+ * at the end is left out of unread unless final is true.
+ *
+ * @param data bytes read from the terminal
+ * @param caps filled with the reported features
+ * @param cursor set to the reported cursor position
+ * @param unread filled with the other bytes
+ * @param final true if no more data will be parsed
+ * @return True if the DA1 reply was found
+ */
+inline bool parseProbe(std::string_view data, term::Capabilities& caps, term::Pos& cursor, std::string& unread,
+                       const bool final)
+{
+    unread.clear();
+    std::size_t i = 0;
+    bool done = false;
+    while(i < data.size()) {
+        if(data[i] != '\x1b') {
+            unread += data[i++];
+            continue;
+        }
+        if(i + 1 >= data.size()) {
+            break;
+        }
+
+        const char kind = data[i + 1];
+        if(kind == '[') {
+            std::size_t j = i + 2;
+            while(j < data.size() && (data[j] < 0x40 || data[j] > 0x7E)) {
+                ++j;
+            }
+            if(j >= data.size()) {
+                break;
+            }
+            const std::string_view params = data.substr(i + 2, j - i - 2);
+            const char prefix = params.empty() ? '\0' : params.front();
+            const char op = data[j];
+            if(op == 'c' && prefix == '?') {
+                caps.deviceAttributes = probeNumbers(params);
+                done = true;
+            } else if(op == 'c' && prefix == '>') {
+                const std::vector<int> numbers = probeNumbers(params);
+                if(numbers.size() >= 2) {
+                    caps.terminalType = numbers[0];
+                    caps.firmwareVersion = numbers[1];
+                }
+            } else if(op == 'y' && prefix == '?' && params.back() == '$') {
+                // Mode;state: 1 set, 2 reset, 3 permanently set. 4 is
+                // permanently reset, the mode can never be enabled
+                const std::vector<int> numbers = probeNumbers(params);
+                if(numbers.size() == 2) {
+                    const bool usable = numbers[1] >= 1 && numbers[1] <= 3;
+                    if(numbers[0] == 2026) {
+                        caps.synchronizedOutput = usable;
+                    } else if(numbers[0] == 2004) {
+                        caps.bracketedPaste = usable;
+                    } else if(numbers[0] == 1006) {
+                        caps.sgrMouse = usable;
+                    }
+                }
+            } else if(op == 'R' && prefix >= '0' && prefix <= '9') {
+                const std::vector<int> numbers = probeNumbers(params);
+                if(numbers.size() == 2) {
+                    cursor = term::Pos(static_cast<std::size_t>(numbers[0]), static_cast<std::size_t>(numbers[1]));
+                }
+            } else {
+                unread.append(data.substr(i, j + 1 - i));
+            }
+            i = j + 1;
+        } else if(kind == 'P' || kind == ']') {
+            // DCS ends with ST, OSC with ST or BEL
+            std::size_t end = i + 2;
+            std::size_t next = std::string_view::npos;
+            for(; end < data.size(); ++end) {
+                if(kind == ']' && data[end] == '\a') {
+                    next = end + 1;
+                    break;
+                }
+                if(data[end] == '\x1b' && end + 1 < data.size() && data[end + 1] == '\\') {
+                    next = end + 2;
+                    break;
+                }
+            }
+            if(next == std::string_view::npos) {
+                break;
+            }
+            const std::string_view body = data.substr(i + 2, end - i - 2);
+            if(kind == 'P' && body.substr(0, 2) == ">|") {
+                caps.version = std::string(body.substr(2));
+            } else if(kind == ']' && body.substr(0, 3) == "10;") {
+                caps.foreground = probeColor(body.substr(3));
+            } else if(kind == ']' && body.substr(0, 3) == "11;") {
+                caps.background = probeColor(body.substr(3));
+            }
+            i = next;
+        } else {
+            unread += data[i++];
+        }
+    }
+    if(final) {
+        unread.append(data.substr(i));
+    }
+    return done;
+}
+
+};
+
+namespace term
+{
+
+  /**
+   * @brief Ask the terminal for its features in a single round trip
+   *
+   * All the queries are sent in one write and the replies read until the
+   * DA1 reply, which ends the batch, or until the timeout. Queries the
+   * terminal does not know are not answered and leave their fields unset.
+   * Input is switched to non canonical mode without echo meanwhile.
+   *
+   * @param caps filled with the reported features, see Capabilities::probed
+   * @param timeout maximum time waiting for the replies. Default is 500ms
+   * @param cursor if not null, set to the cursor position from 1,1
+   * @param unread if not null, filled with bytes read which are not replies
+   * @param in input file descriptor. Default is stdin
+   * @param out output file descriptor. Default is stdout
+   * @return True if the terminal answered before the timeout
+   */
+  inline bool probeTerminal(Capabilities& caps, const std::chrono::milliseconds timeout = std::chrono::milliseconds(500),
+			    Pos *cursor = nullptr, std::string *unread = nullptr, const int in = 0,
+			    const int out = 1)
+  {
+#ifdef __linux__
+    if (!isatty(in) || !isatty(out))
+    {
+      return false;
+    }
+    if (out == STDOUT_FILENO)
+    {
+      std::cout << std::flush;
+    }
+
+    termios saved;
+    if (tcgetattr(in, &saved) != 0)
+    {
+      return false;
+    }
+    termios raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(in, TCSANOW, &raw);
+
+    std::size_t sent = 0;
+    while (sent < termUtils::PROBE_QUERIES.size())
+    {
+      const ssize_t n = ::write(out, termUtils::PROBE_QUERIES.data() + sent, termUtils::PROBE_QUERIES.size() - sent);
+      if (n < 0 && errno != EINTR)
+      {
+	tcsetattr(in, TCSANOW, &saved);
+	return false;
+      }
+      sent += n > 0 ? static_cast<std::size_t>(n) : 0;
+    }
+
+    std::string data;
+    std::string rest;
+    Pos pos;
+    bool done = false;
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done)
+    {
+      const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0)
+      {
+	break;
+      }
+      pollfd fd = { in, POLLIN, 0 };
+      const int ready = poll(&fd, 1, static_cast<int>(left.count()));
+      if (ready < 0 && errno != EINTR)
+      {
+	break;
+      }
+      if (ready <= 0)
+      {
+	continue;
+      }
+      char buf[1024];
+      const ssize_t n = ::read(in, buf, sizeof(buf));
+      if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN))
+      {
+	break;
+      }
+      if (n > 0)
+      {
+	data.append(buf, static_cast<std::size_t>(n));
+	done = termUtils::parseProbe(data, caps, pos, rest, false);
+      }
+    }
+    tcsetattr(in, TCSANOW, &saved);
+
+    termUtils::parseProbe(data, caps, pos, rest, true);
+    caps.probed = done;
+    if (cursor != nullptr)
+    {
+      *cursor = pos;
+    }
+    if (unread != nullptr)
+    {
+      *unread = std::move(rest);
+    }
+    return done;
+#else
+    (void) caps;
+    (void) timeout;
+    (void) cursor;
+    (void) unread;
+    (void) in;
+    (void) out;
+    return false;
+#endif
+  }
+
+  /**
+   * @brief Probe the terminal and use the reported features in the library
+   *
+   * @param timeout maximum time waiting for the replies. Default is 500ms
+   * @return False if the terminal did not answer in time
+   */
+  inline bool probeCapabilities(const std::chrono::milliseconds timeout = std::chrono::milliseconds(500))
+  {
+    Capabilities caps = capabilities();
+    const bool answered = probeTerminal(caps, timeout);
+    setCapabilities(caps);
+    return answered;
+  }
+
+}
+
+#endif // PROBE_HPP
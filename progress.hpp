@@ -0,0 +1,276 @@
+#ifndef PROGRESS_HPP
+#define PROGRESS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cell.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Set of progress bars updated from many threads
+   *
+   * Each bar takes one row of the area: a label, the bar and a percentage.
+   * Values are stored in atomics so any thread can update them without lock.
+   * render() remembers what was drawn for each bar and only rewrites the
+   * cells which changed, at most once per bar and per minimum interval.
+   */
+  class ProgressBars
+  {
+    public:
+      using Clock = std::chrono::steady_clock;
+
+      /** @brief Resolution of a bar value */
+      static constexpr std::uint32_t SCALE = 1u << 16;
+
+      /**
+       * @brief Create an empty set of bars
+       *
+       * @param area screen area, one bar per row
+       * @param labelCols width of the labels
+       * @param style style of the filled part of the bars
+       */
+      ProgressBars(const Rect& area, const std::size_t labelCols = 20, const Style& style = Style())
+	  : area(area), labelCols(labelCols), filled(style)
+      {
+	// Label, space, bar, space and percentage
+	barCols = area.cols > labelCols + 6 ? area.cols - labelCols - 6 : 1;
+      }
+
+      ProgressBars(const ProgressBars&) = delete;
+      ProgressBars& operator=(const ProgressBars&) = delete;
+
+      /**
+       * @brief Add a bar. Not thread safe, call before updates start
+       *
+       * @param label text shown before the bar
+       * @return Index of the bar
+       */
+      std::size_t add(std::string_view label)
+      {
+	bars.push_back(std::make_unique<Bar>());
+	bars.back()->label = label;
+	return bars.size() - 1;
+      }
+
+      /** @brief Number of bars */
+      std::size_t size() const
+      {
+	return bars.size();
+      }
+
+      /**
+       * @brief Set the progress of a bar. Thread safe
+       *
+       * @param bar index of the bar
+       * @param fraction progress between 0 and 1
+       */
+      void set(const std::size_t bar, const double fraction)
+      {
+	const double f = std::clamp(fraction, 0.0, 1.0);
+	bars[bar]->value.store(static_cast<std::uint32_t>(f * SCALE), std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Set the progress of a bar from a count. Thread safe
+       *
+       * @param bar index of the bar
+       * @param done work done
+       * @param total total work
+       */
+      void set(const std::size_t bar, const std::uint64_t done, const std::uint64_t total)
+      {
+	const std::uint64_t value = total == 0 ? SCALE : std::min<std::uint64_t>(done, total) * SCALE / total;
+	bars[bar]->value.store(static_cast<std::uint32_t>(value), std::memory_order_relaxed);
+      }
+
+      /** @brief Progress of a bar between 0 and 1. Thread safe */
+      double get(const std::size_t bar) const
+      {
+	return static_cast<double>(bars[bar]->value.load(std::memory_order_relaxed)) / SCALE;
+      }
+
+      /** @brief Minimum time between two redraws of the same bar */
+      void setMinInterval(const Clock::duration interval)
+      {
+	minInterval = interval;
+      }
+
+      /** @brief Redraw every bar on next render() */
+      void invalidate()
+      {
+	redraw = true;
+      }
+
+      /**
+       * @brief Draw the changes since last call
+       *
+       * Only one thread may call render().
+       *
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       * @return True if something was written
+       */
+      bool render(std::ostream& os = std::cout, const bool flush = true)
+      {
+	out.clear();
+	termUtils::Emitter emitter(out);
+	const Clock::time_point now = Clock::now();
+	const std::size_t count = std::min(bars.size(), area.rows);
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+	  Bar& bar = *bars[i];
+	  const std::uint32_t value = bar.value.load(std::memory_order_relaxed);
+	  const std::size_t row = area.row + i;
+	  if (redraw)
+	  {
+	    drawFrame(emitter, bar, row);
+	  }
+	  else if (value == bar.drawn || (now - bar.time < minInterval && value != SCALE))
+	  {
+	    continue;
+	  }
+
+	  const std::size_t eighths = static_cast<std::uint64_t>(value) * barCols * 8 / SCALE;
+	  const std::size_t percent = static_cast<std::uint64_t>(value) * 100 / SCALE;
+	  if (redraw || eighths != bar.eighths)
+	  {
+	    drawBar(emitter, row, redraw ? 0 : bar.eighths, eighths);
+	    bar.eighths = eighths;
+	  }
+	  if (redraw || percent != bar.percent)
+	  {
+	    drawPercent(emitter, row, percent);
+	    bar.percent = percent;
+	  }
+	  bar.drawn = value;
+	  bar.time = now;
+	}
+	redraw = false;
+
+	if (out.empty())
+	{
+	  return false;
+	}
+	emitter.reset();
+	os.write(out.data(), static_cast<std::streamsize>(out.size()));
+	if (flush)
+	{
+	  os << std::flush;
+	}
+	return true;
+      }
+
+    private:
+      struct Bar
+      {
+	  // Written by producers, on its own cache line
+	  alignas(64) std::atomic<std::uint32_t> value { 0 };
+	  // State of the renderer
+	  alignas(64) std::uint32_t drawn = 0;
+	  std::size_t eighths = 0;
+	  std::size_t percent = 0;
+	  Clock::time_point time;
+	  std::string label;
+      };
+
+      /** @brief Partial blocks from one to eight eighths */
+      static constexpr char32_t BLOCKS[] = { U' ', U'▏', U'▎', U'▍', U'▌', U'▋', U'▊',
+					     U'▉', U'█' };
+
+      Rect area;
+      std::size_t labelCols;
+      std::size_t barCols;
+      Style filled;
+      std::vector<std::unique_ptr<Bar>> bars;
+      Clock::duration minInterval = std::chrono::milliseconds(50);
+      bool redraw = true;
+      std::string out;
+
+      /** @brief Draw the label and the borders of an empty bar */
+      void drawFrame(termUtils::Emitter& emitter, const Bar& bar, const std::size_t row)
+      {
+	emitter.move(row, area.col);
+	std::size_t i = 0;
+	std::size_t col = 0;
+	std::string_view label(bar.label);
+	while (i < label.size() && col < labelCols)
+	{
+	  emitter.put(Cell { termUtils::decodeUtf8(label, i), Style() });
+	  ++col;
+	}
+	for (; col < labelCols + 1; ++col)
+	{
+	  emitter.put(Cell());
+	}
+      }
+
+      /** @brief Rewrite the cells of a bar between two fill levels */
+      void drawBar(termUtils::Emitter& emitter, const std::size_t row, const std::size_t from, const std::size_t to)
+      {
+	const std::size_t first = std::min(from, to) / 8;
+	const std::size_t last = std::min((std::max(from, to) + 7) / 8, barCols);
+	if (redraw)
+	{
+	  emitter.move(row, area.col + labelCols + 1);
+	  for (std::size_t c = 0; c < barCols; ++c)
+	  {
+	    emitter.put(Cell { cell(c, to), filled });
+	  }
+	  return;
+	}
+	emitter.move(row, area.col + labelCols + 1 + first);
+	for (std::size_t c = first; c < std::max(last, first + 1) && c < barCols; ++c)
+	{
+	  emitter.put(Cell { cell(c, to), filled });
+	}
+      }
+
+      /** @brief Character of a bar cell for a fill level */
+      static char32_t cell(const std::size_t c, const std::size_t eighths)
+      {
+	if (eighths >= (c + 1) * 8)
+	{
+	  return BLOCKS[8];
+	}
+	if (eighths <= c * 8)
+	{
+	  return BLOCKS[0];
+	}
+	return BLOCKS[eighths - c * 8];
+      }
+
+      void drawPercent(termUtils::Emitter& emitter, const std::size_t row, const std::size_t percent)
+      {
+	emitter.move(row, area.col + labelCols + 1 + barCols + 1);
+	char text[5] = "   %";
+	std::size_t p = percent;
+	for (int i = 2; i >= 0; --i)
+	{
+	  text[i] = static_cast<char>('0' + p % 10);
+	  p /= 10;
+	  if (p == 0)
+	  {
+	    break;
+	  }
+	}
+	for (std::size_t i = 0; i < 4; ++i)
+	{
+	  emitter.put(Cell { static_cast<char32_t>(text[i]), Style() });
+	}
+      }
+  };
+
+}
+
+#endif // PROGRESS_HPP
@@ -0,0 +1,223 @@
+#ifndef ROWCACHE_HPP
+#define ROWCACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "cell.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Cache of the bytes drawing rows of cells
+   *
+   * Rows are keyed by a 128 bit hash of their cells and styles, the cells
+   * themselves are not kept. The bytes of a row are rendered from an unknown
+   * style, without cursor move, so they can be reused at any position.
+   * Least recently used rows are evicted when the cache exceeds its byte
+   * budget. Not thread safe.
+   */
+  class RowCache
+  {
+    public:
+      /**
+       * @brief Create a cache
+       *
+       * @param budget maximum bytes used by the cached rows
+       */
+      explicit RowCache(const std::size_t budget = 4 * 1024 * 1024)
+	  : budget(budget)
+      {
+      }
+
+      RowCache(const RowCache&) = delete;
+      RowCache& operator=(const RowCache&) = delete;
+
+      /** @brief Bytes used by the cached rows */
+      std::size_t bytes() const
+      {
+	return used;
+      }
+
+      std::size_t hits() const
+      {
+	return hitCount;
+      }
+
+      std::size_t misses() const
+      {
+	return missCount;
+      }
+
+      void clear()
+      {
+	entries.clear();
+	index.clear();
+	used = 0;
+      }
+
+      /**
+       * @brief Draw cells at the cursor position from the cache
+       *
+       * @param emitter emitter to draw with, the cursor already placed
+       * @param cells cells to draw
+       * @param count number of cells
+       * @param width width of the screen
+       */
+      void draw(termUtils::Emitter& emitter, const Cell *cells, const std::size_t count, const std::size_t width)
+      {
+	if (count == 0)
+	{
+	  return;
+	}
+	const Entry& entry = get(cells, count);
+	emitter.raw(entry.bytes, cells[count - 1].style, count, width);
+      }
+
+      /**
+       * @brief Draw the rows of a rectangle which differ between two buffers
+       *
+       * Rows mostly changed are drawn whole from the cache, the others cell
+       * by cell.
+       *
+       * @param emitter emitter to draw with
+       * @param front cells currently on the terminal
+       * @param back cells to display, same size as front
+       * @param rect area to compare
+       */
+      void diff(termUtils::Emitter& emitter, const CellBuffer& front, const CellBuffer& back, const Rect& rect)
+      {
+	const Rect rc = rect.intersect(Rect { 0, 0, back.rows(), back.cols() });
+	for (std::size_t r = rc.row; r < rc.row + rc.rows; ++r)
+	{
+	  const Cell *a = front.row(r) + rc.col;
+	  const Cell *b = back.row(r) + rc.col;
+	  std::size_t changed = 0;
+	  for (std::size_t c = 0; c < rc.cols; ++c)
+	  {
+	    changed += a[c] == b[c] ? 0 : 1;
+	  }
+	  if (changed == 0)
+	  {
+	    continue;
+	  }
+	  if (changed * 2 >= rc.cols)
+	  {
+	    emitter.move(r, rc.col);
+	    draw(emitter, b, rc.cols, back.cols());
+	  }
+	  else
+	  {
+	    emitter.diff(front, back, Rect { r, rc.col, 1, rc.cols });
+	  }
+	}
+      }
+
+      /** @brief Draw all the rows of a rectangle from the cache */
+      void full(termUtils::Emitter& emitter, const CellBuffer& back, const Rect& rect)
+      {
+	const Rect rc = rect.intersect(Rect { 0, 0, back.rows(), back.cols() });
+	for (std::size_t r = rc.row; r < rc.row + rc.rows; ++r)
+	{
+	  emitter.move(r, rc.col);
+	  draw(emitter, back.row(r) + rc.col, rc.cols, back.cols());
+	}
+      }
+
+    private:
+      struct Entry
+      {
+	  std::uint64_t hash;
+	  std::uint64_t check;
+	  std::string bytes;
+      };
+
+      std::size_t budget;
+      std::size_t used = 0;
+      std::size_t hitCount = 0;
+      std::size_t missCount = 0;
+      // Most recently used first
+      std::list<Entry> entries;
+      std::unordered_multimap<std::uint64_t, std::list<Entry>::iterator> index;
+
+      /** @brief Two independent 64 bit hashes of the cells */
+      static void hash(const Cell *cells, const std::size_t count, std::uint64_t& h, std::uint64_t& check)
+      {
+	h = 0xcbf29ce484222325ull ^ count;
+	check = 0x9e3779b97f4a7c15ull + count;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+	  const Cell& c = cells[i];
+	  const std::uint64_t a = std::uint64_t(c.ch) << 32 | c.style.attrs;
+	  const std::uint64_t b = std::uint64_t(c.style.fg) << 32 | c.style.bg;
+	  h = ((h ^ a) * 0x100000001b3ull ^ b) * 0x100000001b3ull;
+	  h ^= h >> 29;
+	  check = (check ^ (a * 0xff51afd7ed558ccdull) ^ (b * 0xc4ceb9fe1a85ec53ull)) * 0x9e3779b97f4a7c15ull;
+	  check ^= check >> 32;
+	}
+      }
+
+      static std::size_t cost(const Entry& entry)
+      {
+	return entry.bytes.size() + sizeof(Entry);
+      }
+
+      const Entry& get(const Cell *cells, const std::size_t count)
+      {
+	std::uint64_t h = 0;
+	std::uint64_t check = 0;
+	hash(cells, count, h, check);
+	auto range = index.equal_range(h);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+	  if (it->second->check == check)
+	  {
+	    ++hitCount;
+	    entries.splice(entries.begin(), entries, it->second);
+	    return entries.front();
+	  }
+	}
+
+	++missCount;
+	Entry entry { h, check, std::string() };
+	termUtils::Emitter emitter(entry.bytes);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+	  emitter.put(cells[i]);
+	}
+	used += cost(entry);
+	entries.push_front(std::move(entry));
+	index.emplace(h, entries.begin());
+
+	// Keep at least the new entry
+	while (used > budget && entries.size() > 1)
+	{
+	  evict();
+	}
+	return entries.front();
+      }
+
+      void evict()
+      {
+	const Entry& entry = entries.back();
+	auto range = index.equal_range(entry.hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+	  if (&*it->second == &entry)
+	  {
+	    index.erase(it);
+	    break;
+	  }
+	}
+	used -= cost(entry);
+	entries.pop_back();
+      }
+  };
+
+}
+
+#endif // ROWCACHE_HPP
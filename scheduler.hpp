@@ -0,0 +1,206 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace term
+{
+
+  /**
+   * @brief Frame paced render scheduler
+   *
+   * Redraw requests from any thread are coalesced with invalidate() and the
+   * render function is called at most once per frame interval, on the
+   * scheduler's own thread. Nothing is rendered while nothing is dirty and the
+   * thread sleeps until the next invalidation.
+   */
+  class FrameScheduler
+  {
+    public:
+      using Clock = std::chrono::steady_clock;
+      /** @brief Function rendering a frame */
+      using RenderFunction = std::function<void()>;
+      /** @brief Function called with the delay of a frame finished too late */
+      using MissedFunction = std::function<void(Clock::duration)>;
+
+      /** @brief Default frame interval, 60 Hz */
+      static constexpr Clock::duration DEFAULT_INTERVAL = std::chrono::microseconds(16667);
+
+      /**
+       * @brief Create a scheduler. The thread is started by start()
+       *
+       * @param render function rendering a frame
+       * @param interval minimum time between two frames. Default is 60 Hz
+       */
+      FrameScheduler(RenderFunction render, const Clock::duration interval = DEFAULT_INTERVAL)
+	  : render(std::move(render)), interval(interval)
+      {
+      }
+
+      FrameScheduler(const FrameScheduler&) = delete;
+      FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+      ~FrameScheduler()
+      {
+	stop();
+      }
+
+      /**
+       * @brief Start the render thread
+       */
+      void start()
+      {
+	if (thread.joinable())
+	{
+	  return;
+	}
+	running = true;
+	thread = std::thread(&FrameScheduler::run, this);
+      }
+
+      /**
+       * @brief Stop the render thread. A pending frame is not rendered
+       */
+      void stop()
+      {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  running = false;
+	}
+	cv.notify_one();
+	if (thread.joinable())
+	{
+	  thread.join();
+	}
+      }
+
+      /**
+       * @brief Request a redraw. Can be called from any thread
+       *
+       * Requests made before the next frame starts are merged into that frame.
+       */
+      void invalidate()
+      {
+	requests.fetch_add(1, std::memory_order_relaxed);
+	if (!dirty.exchange(true, std::memory_order_acq_rel))
+	{
+	  // Taking the lock orders the flag with the wait predicate
+	  std::lock_guard<std::mutex> lock(mutex);
+	  cv.notify_one();
+	}
+      }
+
+      /**
+       * @brief Change the frame interval
+       *
+       * @param value minimum time between two frames
+       */
+      void setInterval(const Clock::duration value)
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	interval = value;
+      }
+
+      /**
+       * @brief Set the function called when a frame ends after its deadline
+       *
+       * Must be set before start().
+       *
+       * @param function called on the render thread with the delay
+       */
+      void onMissedDeadline(MissedFunction function)
+      {
+	missed = std::move(function);
+      }
+
+      /** @brief Number of frames rendered */
+      std::size_t framesRendered() const
+      {
+	return frames.load(std::memory_order_relaxed);
+      }
+
+      /** @brief Number of redraw requests received */
+      std::size_t invalidations() const
+      {
+	return requests.load(std::memory_order_relaxed);
+      }
+
+      /** @brief Number of frames which ended after their deadline */
+      std::size_t missedDeadlines() const
+      {
+	return missedCount.load(std::memory_order_relaxed);
+      }
+
+    private:
+      RenderFunction render;
+      MissedFunction missed;
+      Clock::duration interval;
+      std::thread thread;
+      std::mutex mutex;
+      std::condition_variable cv;
+      bool running = false;
+      std::atomic<bool> dirty { false };
+      std::atomic<std::size_t> requests { 0 };
+      std::atomic<std::size_t> frames { 0 };
+      std::atomic<std::size_t> missedCount { 0 };
+
+      void run()
+      {
+	Clock::time_point last = Clock::now() - interval;
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (running)
+	{
+	  // Idle until something is invalidated
+	  cv.wait(lock, [this]
+	  {
+	    return !running || dirty.load(std::memory_order_acquire);
+	  });
+	  if (!running)
+	  {
+	    break;
+	  }
+
+	  // Pace: wait for the end of the current frame interval
+	  const Clock::time_point next = last + interval;
+	  if (cv.wait_until(lock, next, [this] { return !running; }))
+	  {
+	    break;
+	  }
+
+	  const Clock::duration frame = interval;
+	  lock.unlock();
+
+	  const Clock::time_point start = Clock::now();
+	  // Requests arriving from now on belong to the next frame
+	  dirty.store(false, std::memory_order_release);
+	  render();
+	  frames.fetch_add(1, std::memory_order_relaxed);
+
+	  const Clock::time_point end = Clock::now();
+	  const Clock::time_point deadline = std::max(start, next) + frame;
+	  if (end > deadline)
+	  {
+	    missedCount.fetch_add(1, std::memory_order_relaxed);
+	    if (missed)
+	    {
+	      missed(end - deadline);
+	    }
+	  }
+	  last = start;
+
+	  lock.lock();
+	}
+      }
+  };
+
+}
+
+#endif // SCHEDULER_HPP
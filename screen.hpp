@@ -0,0 +1,254 @@
+#ifndef SCREEN_HPP
+#define SCREEN_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cell.hpp"
+#include "rowCache.hpp"
+#include "trace.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Rectangle of a Screen owned by one producer thread
+   *
+   * The producer draws into its own back buffer and publishes it with commit().
+   * Buffers are exchanged with the compositor through a lock free triple
+   * buffer, so producers never wait on each other nor on the compositor.
+   * Coordinates are relative to the region.
+   */
+  class Region
+  {
+    public:
+      explicit Region(const Rect& rect)
+	  : area(rect)
+      {
+	for (CellBuffer& buffer : buffers)
+	{
+	  buffer.resize(Size(rect.rows, rect.cols));
+	}
+      }
+
+      Region(const Region&) = delete;
+      Region& operator=(const Region&) = delete;
+
+      /** @brief Position and size of the region on the screen */
+      const Rect& rect() const
+      {
+	return area;
+      }
+
+      /** @brief Back buffer of the producer */
+      CellBuffer& buffer()
+      {
+	return buffers[back];
+      }
+
+      /** @brief Set a cell of the back buffer, ignored outside the region */
+      void put(const std::size_t row, const std::size_t col, const Cell& cell)
+      {
+	if (row < area.rows && col < area.cols)
+	{
+	  buffers[back].at(row, col) = cell;
+	}
+      }
+
+      /**
+       * @brief Write UTF-8 text in the back buffer, clipped to the region
+       *
+       * @return Column after the last written cell
+       */
+      std::size_t print(const std::size_t row, const std::size_t col, std::string_view text, const Style& style =
+			    Style())
+      {
+	return buffers[back].print(row, col, text, style);
+      }
+
+      /** @brief Fill the back buffer */
+      void fill(const Cell& cell = Cell())
+      {
+	buffers[back].fill(cell);
+      }
+
+      /**
+       * @brief Publish the back buffer to the compositor
+       *
+       * The new back buffer starts with the published content so drawing can
+       * go on incrementally.
+       */
+      void commit()
+      {
+	const std::uint8_t published = back;
+	back = middle.exchange(published | DIRTY, std::memory_order_acq_rel) & INDEX;
+	buffers[back] = buffers[published];
+      }
+
+    private:
+      friend class Screen;
+
+      static constexpr std::uint8_t INDEX = 3;
+      static constexpr std::uint8_t DIRTY = 4;
+
+      Rect area;
+      CellBuffer buffers[3];
+      // Producer side
+      std::uint8_t back = 0;
+      // Compositor side
+      std::uint8_t front = 1;
+      alignas(64) std::atomic<std::uint8_t> middle { 2 };
+
+      /** @brief Take the last published buffer, false if nothing new */
+      bool acquire()
+      {
+	if ((middle.load(std::memory_order_relaxed) & DIRTY) == 0)
+	{
+	  return false;
+	}
+	front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+	return true;
+      }
+  };
+
+  /**
+   * @brief Off-screen buffer shared by regions drawn from several threads
+   *
+   * Regions are created before producers start. compose() is called from a
+   * single compositor thread: it merges the regions published since the last
+   * call and writes only the cells which changed. Regions are not expected to
+   * overlap.
+   */
+  class Screen
+  {
+    public:
+      explicit Screen(const Size& size = term::size())
+	  : current(size), next(size)
+      {
+      }
+
+      Screen(const Screen&) = delete;
+      Screen& operator=(const Screen&) = delete;
+
+      const Size& size() const
+      {
+	return next.size();
+      }
+
+      /**
+       * @brief Create a region. Not thread safe
+       *
+       * @param rect position and size on the screen, clipped to the screen
+       * @return The region, valid as long as the screen
+       */
+      Region& region(const Rect& rect)
+      {
+	regions.emplace_back(std::make_unique<Region>(rect.intersect(Rect { 0, 0, size().rows, size().cols })));
+	return *regions.back();
+      }
+
+      /**
+       * @brief Draw mostly changed rows from a cache of rendered rows
+       *
+       * @param rowCache cache outliving this object, nullptr to disable
+       */
+      void setRowCache(RowCache *rowCache)
+      {
+	cache = rowCache;
+      }
+
+      /** @brief Redraw the whole screen on next compose() */
+      void invalidate()
+      {
+	redraw = true;
+      }
+
+      /**
+       * @brief Merge published regions and draw the changes
+       *
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       * @return True if something was written
+       */
+      bool compose(std::ostream& os = std::cout, const bool flush = true)
+      {
+	TERM_TRACE_SCOPE(Build);
+	damage.clear();
+	for (const std::unique_ptr<Region>& region : regions)
+	{
+	  if (region->acquire())
+	  {
+	    const Rect& rc = region->rect();
+	    next.blit(region->buffers[region->front], Rect { 0, 0, rc.rows, rc.cols }, rc.row, rc.col);
+	    damage.push_back(rc);
+	  }
+	}
+
+	out.clear();
+	termUtils::Emitter emitter(out);
+	const Rect all { 0, 0, size().rows, size().cols };
+	if (redraw)
+	{
+	  out += clear::ALL_SCREEN;
+	  if (cache != nullptr)
+	  {
+	    cache->full(emitter, next, all);
+	  }
+	  else
+	  {
+	    emitter.full(next, all);
+	  }
+	  current.blit(next, all, 0, 0);
+	  redraw = false;
+	}
+	else
+	{
+	  TERM_TRACE_SCOPE(Diff);
+	  for (const Rect& rc : damage)
+	  {
+	    if (cache != nullptr)
+	    {
+	      cache->diff(emitter, current, next, rc);
+	    }
+	    else
+	    {
+	      emitter.diff(current, next, rc);
+	    }
+	    current.blit(next, rc, rc.row, rc.col);
+	  }
+	}
+
+	if (out.empty())
+	{
+	  return false;
+	}
+	emitter.reset();
+	TERM_TRACE_SCOPE(Write);
+	os.write(out.data(), static_cast<std::streamsize>(out.size()));
+	if (flush)
+	{
+	  os << std::flush;
+	}
+	return true;
+      }
+
+    private:
+      std::vector<std::unique_ptr<Region>> regions;
+      // Cells on the terminal
+      CellBuffer current;
+      // Cells to display
+      CellBuffer next;
+      std::vector<Rect> damage;
+      std::string out;
+      RowCache *cache = nullptr;
+      bool redraw = true;
+  };
+
+}
+
+#endif // SCREEN_HPP
@@ -0,0 +1,312 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "capabilities.hpp"
+#include "cell.hpp"
+
+namespace termUtils
+{
+
+/** @brief Append an unsigned number in LEB128, 7 bits per byte */
+inline void appendVarint(std::string& out, std::uint64_t value)
+{
+    while(value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+/**
+ * @brief Read a number written by appendVarint()
+ *
+ * @param data bytes
+ * @param pos position, moved after the number
+ * @param value set to the number
+ * @return False if the data ends inside the number or it is too long
+ */
+inline bool readVarint(const std::string_view data, std::size_t& pos, std::uint64_t& value)
+{
+    value = 0;
+    for(unsigned shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        const unsigned char byte = static_cast<unsigned char>(data[pos++]);
+        value |= std::uint64_t(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+namespace term
+{
+
+  /** @brief Terminal modes kept by a snapshot */
+  struct ScreenModes
+  {
+      /** @brief Alternate screen, see saveScreen() */
+      bool altScreen = false;
+      bool cursorVisible = true;
+
+      bool operator ==(const ScreenModes&) const = default;
+  };
+
+  /**
+   * @brief Visible state of a terminal: cells, cursor and modes
+   *
+   * A session detached from its terminal keeps a snapshot; on reattach,
+   * replay() gives the bytes drawing it on a fresh terminal, without running
+   * the application render. save() and load() convert it to a compact binary
+   * form: styles are interned in a table and equal cells run length encoded.
+   *
+   * Binary form, numbers in LEB128 unless noted:
+   *  - "TSNP", version byte, mode flags byte
+   *  - rows, cols, cursor row, cursor col
+   *  - style count, then fg, bg and attrs of each style
+   *  - runs covering the cells row by row: count << 1 | style changed, the
+   *    style index if changed, then the code point
+   */
+  class Snapshot
+  {
+    public:
+      Snapshot()
+      {
+      }
+
+      /**
+       * @brief Capture a state
+       *
+       * @param cells cells on the screen
+       * @param cursor cursor position, from 0,0
+       * @param modes terminal modes
+       */
+      Snapshot(const CellBuffer& cells, const Pos& cursor, const ScreenModes& modes = ScreenModes())
+      {
+	capture(cells, cursor, modes);
+      }
+
+      /** @brief Capture a state, see Snapshot() */
+      void capture(const CellBuffer& cells, const Pos& cursor, const ScreenModes& modes = ScreenModes())
+      {
+	screen.resize(cells.size());
+	screen.blit(cells, Rect { 0, 0, cells.rows(), cells.cols() }, 0, 0);
+	pos = cursor;
+	mode = modes;
+      }
+
+      const CellBuffer& cells() const
+      {
+	return screen;
+      }
+
+      /** @brief Cursor position, from 0,0 */
+      const Pos& cursor() const
+      {
+	return pos;
+      }
+
+      const ScreenModes& modes() const
+      {
+	return mode;
+      }
+
+      /**
+       * @brief Append the binary form
+       *
+       * @param out output buffer
+       */
+      void save(std::string& out) const
+      {
+	out += MAGIC;
+	out += static_cast<char>(VERSION);
+	out += static_cast<char>((mode.altScreen ? ALT_SCREEN : 0) | (mode.cursorVisible ? CURSOR_VISIBLE : 0));
+	termUtils::appendVarint(out, screen.rows());
+	termUtils::appendVarint(out, screen.cols());
+	termUtils::appendVarint(out, pos.row);
+	termUtils::appendVarint(out, pos.col);
+
+	// Style indices by first use
+	std::unordered_map<Style, std::uint64_t, StyleHash> index;
+	std::vector<const Style*> table;
+	const Cell *cell = screen.rows() > 0 ? screen.row(0) : nullptr;
+	const std::size_t count = screen.rows() * screen.cols();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+	  if (index.emplace(cell[i].style, table.size()).second)
+	  {
+	    table.push_back(&cell[i].style);
+	  }
+	}
+	termUtils::appendVarint(out, table.size());
+	for (const Style *style : table)
+	{
+	  termUtils::appendVarint(out, style->fg);
+	  termUtils::appendVarint(out, style->bg);
+	  termUtils::appendVarint(out, style->attrs);
+	}
+
+	const Style *current = nullptr;
+	std::size_t i = 0;
+	while (i < count)
+	{
+	  std::size_t n = 1;
+	  while (i + n < count && cell[i + n] == cell[i])
+	  {
+	    ++n;
+	  }
+	  const bool changed = current == nullptr || *current != cell[i].style;
+	  termUtils::appendVarint(out, std::uint64_t(n) << 1 | (changed ? 1 : 0));
+	  if (changed)
+	  {
+	    termUtils::appendVarint(out, index.find(cell[i].style)->second);
+	    current = &cell[i].style;
+	  }
+	  termUtils::appendVarint(out, cell[i].ch);
+	  i += n;
+	}
+      }
+
+      /**
+       * @brief Read a binary form written by save()
+       *
+       * @param data bytes, nothing may follow the snapshot
+       * @return False if the data is not a valid snapshot, which is then
+       * unchanged
+       */
+      bool load(const std::string_view data)
+      {
+	if (data.size() < MAGIC.size() + 2 || data.substr(0, MAGIC.size()) != MAGIC
+	    || static_cast<unsigned char>(data[MAGIC.size()]) != VERSION)
+	{
+	  return false;
+	}
+	const unsigned flags = static_cast<unsigned char>(data[MAGIC.size() + 1]);
+	std::size_t at = MAGIC.size() + 2;
+	std::uint64_t rows, cols, row, col, styles;
+	if (!termUtils::readVarint(data, at, rows) || !termUtils::readVarint(data, at, cols)
+	    || !termUtils::readVarint(data, at, row) || !termUtils::readVarint(data, at, col)
+	    || !termUtils::readVarint(data, at, styles) || rows > MAX_SIZE || cols > MAX_SIZE
+	    || rows * cols > MAX_CELLS || styles > (data.size() - at) / 3)
+	{
+	  return false;
+	}
+
+	std::vector<Style> table(static_cast<std::size_t>(styles));
+	for (Style& style : table)
+	{
+	  std::uint64_t fg, bg, attrs;
+	  if (!termUtils::readVarint(data, at, fg) || !termUtils::readVarint(data, at, bg)
+	      || !termUtils::readVarint(data, at, attrs) || fg > 0xFFFFFFFF || bg > 0xFFFFFFFF || attrs > 0xFFFFFFFF)
+	  {
+	    return false;
+	  }
+	  style = Style { static_cast<std::uint32_t>(fg), static_cast<std::uint32_t>(bg),
+			  static_cast<std::uint32_t>(attrs) };
+	}
+
+	CellBuffer cells(Size(static_cast<std::size_t>(rows), static_cast<std::size_t>(cols)));
+	Cell *cell = rows > 0 ? cells.row(0) : nullptr;
+	const std::size_t count = static_cast<std::size_t>(rows * cols);
+	const Style *current = nullptr;
+	std::size_t i = 0;
+	while (i < count)
+	{
+	  std::uint64_t header, ch;
+	  if (!termUtils::readVarint(data, at, header) || header >> 1 == 0 || header >> 1 > count - i)
+	  {
+	    return false;
+	  }
+	  if (header & 1)
+	  {
+	    std::uint64_t style;
+	    if (!termUtils::readVarint(data, at, style) || style >= table.size())
+	    {
+	      return false;
+	    }
+	    current = &table[static_cast<std::size_t>(style)];
+	  }
+	  if (current == nullptr || !termUtils::readVarint(data, at, ch) || ch > 0x10FFFF)
+	  {
+	    return false;
+	  }
+	  const std::size_t n = static_cast<std::size_t>(header >> 1);
+	  std::fill_n(cell + i, n, Cell { static_cast<char32_t>(ch), *current });
+	  i += n;
+	}
+	if (at != data.size())
+	{
+	  return false;
+	}
+
+	screen = std::move(cells);
+	pos = Pos(static_cast<std::size_t>(row), static_cast<std::size_t>(col));
+	mode.altScreen = (flags & ALT_SCREEN) != 0;
+	mode.cursorVisible = (flags & CURSOR_VISIBLE) != 0;
+	return true;
+      }
+
+      /**
+       * @brief Append the bytes drawing the snapshot on a fresh terminal of
+       * the same size
+       *
+       * Enters the alternate screen if needed, clears it, draws the cells
+       * with the shortest sequences of the terminal, then places and shows
+       * or hides the cursor. The style is left reset.
+       *
+       * @param out output buffer
+       * @param caps features of the terminal. Default is the library profile
+       */
+      void replay(std::string& out, const Capabilities& caps = capabilities()) const
+      {
+	if (mode.altScreen)
+	{
+	  out += caps.enterCaMode;
+	}
+	out += "\x1b[0m\x1b[2J";
+	termUtils::Emitter emitter(out, caps);
+	emitter.full(screen, Rect { 0, 0, screen.rows(), screen.cols() });
+	emitter.reset();
+	emitter.move(std::min(pos.row, screen.rows() > 0 ? screen.rows() - 1 : 0),
+		     std::min(pos.col, screen.cols() > 0 ? screen.cols() - 1 : 0));
+	out += mode.cursorVisible ? termUtils::sequence(caps.cursorNormal, cursor::ON) :
+				    termUtils::sequence(caps.cursorInvisible, cursor::OFF);
+      }
+
+    private:
+      static constexpr std::string_view MAGIC = "TSNP";
+      static constexpr unsigned VERSION = 1;
+      static constexpr unsigned ALT_SCREEN = 1;
+      static constexpr unsigned CURSOR_VISIBLE = 2;
+      /** @brief Largest number of rows or columns loaded */
+      static constexpr std::uint64_t MAX_SIZE = 0xFFFF;
+      /** @brief Largest number of cells loaded, 256 MB */
+      static constexpr std::uint64_t MAX_CELLS = 1 << 24;
+
+      struct StyleHash
+      {
+	  std::size_t operator()(const Style& style) const
+	  {
+	    std::uint64_t h = style.fg * 0x9E3779B97F4A7C15ull;
+	    h ^= (h >> 29) + style.bg * 0xBF58476D1CE4E5B9ull;
+	    h ^= (h >> 31) + style.attrs * 0x94D049BB133111EBull;
+	    return static_cast<std::size_t>(h ^ (h >> 32));
+	  }
+      };
+
+      CellBuffer screen;
+      Pos pos;
+      ScreenModes mode;
+  };
+
+}
+
+#endif // SNAPSHOT_HPP
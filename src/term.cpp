@@ -0,0 +1,5 @@
+/*
+ * Console functions of the term library, see TERM_COMPILED in term.hpp.
+ */
+
+#include "console.hpp"
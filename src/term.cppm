@@ -0,0 +1,228 @@
+/*
+ * The term library as a C++20 module: import term;
+ *
+ * The headers are parsed once when building the module. Macros and the
+ * termUtils namespace are not exported. Built with TERM_BUILD_MODULE, see
+ * CMakeLists.txt.
+ */
+
+module;
+
+#include "term.hpp"
+#include "arena.hpp"
+#include "blit.hpp"
+#include "capabilities.hpp"
+#include "cell.hpp"
+#include "keymap.hpp"
+#include "markup.hpp"
+#include "progress.hpp"
+#include "rowCache.hpp"
+#include "scheduler.hpp"
+#include "screen.hpp"
+#include "snapshot.hpp"
+#include "table.hpp"
+#include "terminfo.hpp"
+#include "window.hpp"
+#include "trace.hpp"
+#include "workPool.hpp"
+#include "frameDiff.hpp"
+#include "fuzzy.hpp"
+#include "probe.hpp"
+#ifdef __linux__
+#include "async.hpp"
+#include "lineEditor.hpp"
+#include "logView.hpp"
+#include "output.hpp"
+#include "pager.hpp"
+#include "terminal.hpp"
+#endif
+
+export module term;
+
+export namespace term
+{
+  // term.hpp
+  using term::RESET;
+  using term::Size;
+  using term::Pos;
+  using term::defaultOutput;
+  using term::reset;
+  using term::size;
+  using term::KeyEvent;
+  using term::decodeKey;
+  using term::isKeyPressed;
+  using term::keyPress;
+  using term::setEchoOn;
+  using term::setEchoOff;
+  using term::initConsole;
+  using term::restoreConsole;
+  using term::saveScreen;
+  using term::restoreScreen;
+  using term::Key;
+
+  // capabilities.hpp, terminfo.hpp, probe.hpp
+  using term::Capabilities;
+  using term::capabilities;
+  using term::setCapabilities;
+  using term::loadTerminfo;
+  using term::initCapabilities;
+  using term::probeTerminal;
+  using term::probeCapabilities;
+
+  // Cells and rendering
+  using term::FrameArena;
+  using term::Style;
+  using term::Cell;
+  using term::Rect;
+  using term::CellBuffer;
+  using term::BlitOptions;
+  using term::Blitter;
+  using term::blitRgb;
+  using term::RowCache;
+  using term::Region;
+  using term::Screen;
+  using term::Window;
+  using term::Compositor;
+  using term::ScreenModes;
+  using term::Snapshot;
+  using term::Table;
+  using term::ProgressBars;
+  using term::FrameScheduler;
+  using term::styled;
+  using term::printStyled;
+  using term::StyledText;
+  using term::styledText;
+
+  // Input
+  using term::Binding;
+  using term::Keymap;
+  using term::KeyDispatcher;
+
+  using term::TraceStage;
+  using term::Histogram;
+  using term::Tracer;
+  using term::tracer;
+  using term::TraceScope;
+
+  using term::WorkPool;
+  using term::FrameDiff;
+  using term::FuzzyMatch;
+  using term::FuzzyFinder;
+
+#ifdef __linux__
+  using term::Task;
+  using term::Reactor;
+  using term::reactor;
+  using term::nextKey;
+  using term::sleepFor;
+  using term::resized;
+  using term::blockResizeSignal;
+  using term::History;
+  using term::LineEditor;
+  using term::LogView;
+  using term::Output;
+  using term::Pager;
+  using term::Terminal;
+#endif
+}
+
+export namespace term::modifier
+{
+  using term::modifier::NONE;
+  using term::modifier::SHIFT;
+  using term::modifier::ALT;
+  using term::modifier::CTRL;
+}
+
+export namespace term::binding
+{
+  using term::binding::NONE;
+  using term::binding::PENDING;
+}
+
+export namespace term::attr
+{
+  using term::attr::NONE;
+  using term::attr::BRIGHT;
+  using term::attr::DIM;
+  using term::attr::UNDERSCORE;
+  using term::attr::BLINK;
+  using term::attr::REVERSE;
+}
+
+export namespace term::clear
+{
+  using term::clear::LINE;
+  using term::clear::LINE_TO_RIGHT;
+  using term::clear::LINE_TO_LEFT;
+  using term::clear::SCREEN;
+  using term::clear::ALL_SCREEN;
+  using term::clear::SCREEN_TO_BOTTOM;
+  using term::clear::SCREEN_TO_TOP;
+  using term::clear::line;
+  using term::clear::lineToRight;
+  using term::clear::lineToLeft;
+  using term::clear::screen;
+  using term::clear::allScreen;
+  using term::clear::screenToBottom;
+  using term::clear::screenToTop;
+}
+
+export namespace term::color
+{
+  using term::color::RESET;
+  using term::color::BG_BLACK;
+  using term::color::BG_RED;
+  using term::color::BG_GREEN;
+  using term::color::BG_YELLOW;
+  using term::color::BG_BLUE;
+  using term::color::BG_MAGENTA;
+  using term::color::BG_CYAN;
+  using term::color::BG_WHITE;
+  using term::color::FG_BLACK;
+  using term::color::FG_RED;
+  using term::color::FG_GREEN;
+  using term::color::FG_YELLOW;
+  using term::color::FG_BLUE;
+  using term::color::FG_MAGENTA;
+  using term::color::FG_CYAN;
+  using term::color::FG_WHITE;
+  using term::color::fg;
+  using term::color::bg;
+  using term::color::fgRgb;
+  using term::color::bgRgb;
+  using term::color::reset;
+  using term::color::DEFAULT;
+  using term::color::indexed;
+  using term::color::rgb;
+}
+
+export namespace term::cursor
+{
+  using term::cursor::ON;
+  using term::cursor::OFF;
+  using term::cursor::ORIGIN;
+  using term::cursor::SAVE;
+  using term::cursor::RESTORE;
+  using term::cursor::on;
+  using term::cursor::off;
+  using term::cursor::move;
+  using term::cursor::moveUp;
+  using term::cursor::moveDown;
+  using term::cursor::moveRight;
+  using term::cursor::moveLeft;
+  using term::cursor::moveToCol;
+  using term::cursor::origin;
+  using term::cursor::save;
+  using term::cursor::restore;
+  using term::cursor::position;
+}
+
+export namespace term::style
+{
+  using term::style::BRIGHT;
+  using term::style::DIM;
+  using term::style::UNDERSCORE;
+  using term::style::BLINK;
+  using term::style::REVERSE;
+}
@@ -0,0 +1,279 @@
+#ifndef TABLE_HPP
+#define TABLE_HPP
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+#include "cell.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief Table drawing only its visible rows
+   *
+   * Rows are pulled from a callback when they become visible, so the data is
+   * never materialized. Column widths start from the headers and grow with
+   * the rows seen: the visible ones and a few sampled across the data at each
+   * render.
+   */
+  class Table
+  {
+    public:
+      /**
+       * @brief Function giving the cells of a row
+       *
+       * The views must stay valid until the next call, or until the end of
+       * the render when they point into arena(), e.g. numbers formatted into
+       * a std::pmr::string.
+       * @return False if the row does not exist
+       */
+      using RowSource = std::function<bool(std::size_t row, std::vector<std::string_view>& cells)>;
+
+      /** @brief Row count of a source whose end is only known by the callback */
+      static constexpr std::size_t UNKNOWN = static_cast<std::size_t>(-1);
+
+      /**
+       * @brief Create a table
+       *
+       * @param headers column titles
+       * @param source function giving the rows
+       * @param rows number of rows, or UNKNOWN
+       */
+      Table(std::vector<std::string> headers, RowSource source, const std::size_t rows = UNKNOWN)
+	  : headers(std::move(headers)), source(std::move(source)), count(rows)
+      {
+	for (const std::string& header : this->headers)
+	{
+	  widths.push_back(columns(header));
+	}
+      }
+
+      /** @brief Number of rows, UNKNOWN if the source end was not reached */
+      std::size_t rows() const
+      {
+	return count;
+      }
+
+      /** @brief Change the number of rows, e.g. when the data grows */
+      void setRows(const std::size_t rows)
+      {
+	count = rows;
+      }
+
+      /** @brief Maximum width of a column */
+      void setMaxWidth(const std::size_t width)
+      {
+	maxWidth = width;
+      }
+
+      /** @brief Number of rows sampled across the data at each render */
+      void setSamples(const std::size_t samples)
+      {
+	sampled = samples;
+      }
+
+      /** @brief First visible row */
+      std::size_t position() const
+      {
+	return top;
+      }
+
+      /** @brief Show a row at the top */
+      void scrollTo(const std::size_t row)
+      {
+	top = count == UNKNOWN ? row : std::min(row, count > 0 ? count - 1 : 0);
+      }
+
+      /** @brief Highlight a row, UNKNOWN for none */
+      void select(const std::size_t row)
+      {
+	selected = row;
+      }
+
+      /** @brief Memory for the cells made by the source, freed at each render */
+      FrameArena& arena()
+      {
+	return *frameArena;
+      }
+
+      /**
+       * @brief Draw the header and the visible rows
+       *
+       * @param view screen area of the table
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       */
+      void render(const Rect& view, std::ostream& os = std::cout, const bool flush = true)
+      {
+	if (view.rows == 0)
+	{
+	  return;
+	}
+	frameArena->reset();
+	sample(view.rows - 1);
+
+	out.clear();
+	termUtils::Emitter emitter(out);
+	emitter.move(view.row, view.col);
+	out += color::RESET;
+	out += style::BRIGHT;
+	out += style::UNDERSCORE;
+	std::size_t col = 0;
+	for (std::size_t c = 0; c < headers.size(); ++c)
+	{
+	  col = appendCell(headers[c], c, col, view.cols);
+	}
+	pad(col, view.cols);
+	out += color::RESET;
+
+	for (std::size_t r = 1; r < view.rows; ++r)
+	{
+	  const std::size_t row = top + r - 1;
+	  emitter.move(view.row + r, view.col);
+	  col = 0;
+	  if (fetch(row))
+	  {
+	    if (row == selected)
+	    {
+	      out += style::REVERSE;
+	    }
+	    for (std::size_t c = 0; c < headers.size(); ++c)
+	    {
+	      col = appendCell(c < cells.size() ? cells[c] : std::string_view(), c, col, view.cols);
+	    }
+	  }
+	  pad(col, view.cols);
+	  if (row == selected)
+	  {
+	    out += color::RESET;
+	  }
+	}
+	os.write(out.data(), static_cast<std::streamsize>(out.size()));
+	if (flush)
+	{
+	  os << std::flush;
+	}
+      }
+
+    private:
+      /** @brief Columns between two cells */
+      static constexpr std::size_t GAP = 2;
+
+      std::vector<std::string> headers;
+      RowSource source;
+      std::size_t count;
+      std::vector<std::size_t> widths;
+      std::vector<std::string_view> cells;
+      std::size_t maxWidth = 40;
+      std::size_t sampled = 8;
+      std::size_t sampleIndex = 0;
+      std::size_t top = 0;
+      std::size_t selected = UNKNOWN;
+      std::string out;
+      // Kept at the same address when the table moves, as the cells point into it
+      std::unique_ptr<FrameArena> frameArena = std::make_unique<FrameArena>(4096);
+
+      /** @brief Number of columns of UTF-8 text */
+      static std::size_t columns(std::string_view text)
+      {
+	return static_cast<std::size_t>(std::count_if(text.begin(), text.end(), [](const char c)
+	{
+	  return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+	}));
+      }
+
+      /** @brief Get a row from the source, false past the end */
+      bool fetch(const std::size_t row)
+      {
+	if (row >= count)
+	{
+	  return false;
+	}
+	cells.clear();
+	if (!source(row, cells))
+	{
+	  // The source end is now known
+	  if (count == UNKNOWN || row < count)
+	  {
+	    count = row;
+	  }
+	  return false;
+	}
+	for (std::size_t c = 0; c < cells.size() && c < widths.size(); ++c)
+	{
+	  widths[c] = std::max(widths[c], std::min(columns(cells[c]), maxWidth));
+	}
+	return true;
+      }
+
+      /** @brief Update the widths from the visible rows and a few others */
+      void sample(const std::size_t visible)
+      {
+	for (std::size_t r = 0; r < visible; ++r)
+	{
+	  if (!fetch(top + r))
+	  {
+	    break;
+	  }
+	}
+	if (count == UNKNOWN || count == 0)
+	{
+	  return;
+	}
+	// Stride through the data with a step prime to most sizes
+	for (std::size_t i = 0; i < sampled; ++i)
+	{
+	  sampleIndex = (sampleIndex + 7919) % count;
+	  fetch(sampleIndex);
+	}
+      }
+
+      /** @brief Append a cell padded to its column width */
+      std::size_t appendCell(std::string_view text, const std::size_t c, std::size_t col, const std::size_t width)
+      {
+	if (c > 0)
+	{
+	  const std::size_t gap = std::min(GAP, width - col);
+	  out.append(gap, ' ');
+	  col += gap;
+	}
+	const std::size_t end = std::min(col + widths[c], width);
+	std::size_t i = 0;
+	while (i < text.size() && col < end)
+	{
+	  const std::size_t start = i;
+	  const char32_t cp = termUtils::decodeUtf8(text, i);
+	  if (cp < 0x20 || cp == 0x7F)
+	  {
+	    out += ' ';
+	  }
+	  else
+	  {
+	    out.append(text.data() + start, i - start);
+	  }
+	  ++col;
+	}
+	pad(col, end);
+	return col;
+      }
+
+      void pad(std::size_t& col, const std::size_t end)
+      {
+	if (col < end)
+	{
+	  out.append(end - col, ' ');
+	  col = end;
+	}
+      }
+  };
+
+}
+
+#endif // TABLE_HPP
@@ -2,32 +2,35 @@
 #define TERM_HPP
 
 #include <algorithm>
-#include <chrono>
-#include <iostream>
+#include <ostream>
+#include <span>
+#include <string>
 #include <string_view>
-#include <thread>
 #include <vector>
 
-#ifdef __linux__
-#include <cstdio>
-#include <sys/ioctl.h>
-#include <sys/select.h>
-#endif
-
-#ifdef _WIN32
-#include <conio.h>
-#include <fcntl.h>
-#include <io.h>
-#include <windows.h>
+/*
+ * Console functions, which need the system headers, are inline and defined
+ * by console.hpp included at the end, unless TERM_COMPILED is defined: they
+ * are then compiled once in the term library, see CMakeLists.txt.
+ */
+#ifndef TERM_COMPILED
+#define TERM_DECL inline
+#elif defined(_WIN32) && defined(TERM_SHARED) && defined(TERM_EXPORTS)
+#define TERM_DECL __declspec(dllexport)
+#elif defined(_WIN32) && defined(TERM_SHARED)
+#define TERM_DECL __declspec(dllimport)
+#else
+#define TERM_DECL
 #endif
 
+#include "capabilities.hpp"
 #include "termUtils.hpp"
 
 namespace term
 {
 
   /** @brief Reset all */
-  constexpr std::string_view RESET("\x1b[!p");
+  inline constexpr std::string_view RESET("\x1b[!p");
 
   /** @brief Numbers of rows and columns */
   struct Size
@@ -73,35 +76,35 @@ namespace term
       }
   };
 
-  /** @brief Reset all function */
-  void reset()
+  /**
+   * @brief Default output of the functions taking a stream, std::cout
+   *
+   * Out of line so that TERM_COMPILED users need not include <iostream>.
+   */
+  TERM_DECL std::ostream& defaultOutput();
+
+  /** @brief Reset all function, soft reset keeping the screen contents */
+  inline void reset()
   {
-    std::cout << RESET << std::flush;
+    defaultOutput() << capabilities().softReset << capabilities().exitAttributes << std::flush;
   }
 
   /**
    * @brief Size of the terminal
    * @return Size rows and cols of terminal
    */
-  Size size()
-  {
-    std::size_t r = 0;
-    std::size_t c = 0;
-
-#ifdef __linux__
-    winsize w;
-    ioctl(fileno(stdout), TIOCGWINSZ, &w);
-    r = w.ws_row;
-    c = w.ws_col;
-#endif
+  TERM_DECL Size size();
 
-#ifdef _WIN32
-    CONSOLE_SCREEN_BUFFER_INFO sbInfo;
-    GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &sbInfo);
-    c = sbInfo.dwSize.X;
-    r = sbInfo.srWindow.Right - sbInfo.srWindow.Left + 1;
-#endif
-    return Size(r, c);
+  namespace modifier
+  {
+    /** @brief No modifier */
+    inline constexpr int NONE = 0;
+    /** @brief Shift modifier */
+    inline constexpr int SHIFT = 1;
+    /** @brief Alt modifier */
+    inline constexpr int ALT = 2;
+    /** @brief Control modifier */
+    inline constexpr int CTRL = 4;
   }
 
   /** @brief Key event */
@@ -109,183 +112,180 @@ namespace term
   {
       term::Key code;
       int value;
+      /** @brief Combination of modifier flags */
+      int modifiers;
+      /** @brief Character typed, 0 for keys which are not characters */
+      char32_t codepoint = 0;
+      /** @brief UTF-8 bytes of the character, see text() */
+      char bytes[4] = { 0, 0, 0, 0 };
+      /** @brief Number of bytes */
+      unsigned char length = 0;
 
-      KeyEvent(term::Key code, int value)
-	  : code(code), value(value)
+      KeyEvent(term::Key code, int value, int modifiers = modifier::NONE)
+	  : code(code), value(value), modifiers(modifiers)
       {
       }
 
       KeyEvent()
-	  : code(term::Key::None), value(0)
+	  : code(term::Key::None), value(0), modifiers(modifier::NONE)
       {
       }
 
-      std::string toChar()
+      /** @brief UTF-8 bytes of the character typed, empty if none */
+      std::string_view text() const
       {
-	char c = static_cast<char>(value);
-	std::string s(&c);
-	return s;
+	return std::string_view(bytes, length);
       }
-  };
 
-  /**
-   * @brief Check if a key is pressed.
-   * @return True if the key is pressed, false otherwise
-   */
-  bool isKeyPressed()
-  {
-    return termUtils::kbHit() > 0;
-  }
+      std::string toChar() const
+      {
+	if (length != 0)
+	{
+	  return std::string(text());
+	}
+	return std::string(1, static_cast<char>(value));
+      }
+  };
 
   /**
-   * @brief Get key presses
-   * @return Key with code and value
+   * @brief Key event of the bytes of one key press, with its modifiers
+   *
+   * Recognizes control characters as Ctrl+letter, escape followed by a key
+   * as Alt+key, upper case letters as Shift+letter and the xterm modifier
+   * parameter of CSI sequences, e.g. "\x1b[1;5A" is Ctrl+Up. A valid UTF-8
+   * sequence gives a Key::Text event with its code point. Combining marks
+   * come as separate events.
+   *
+   * @param chars bytes of the key press
    */
-  KeyEvent keyPress()
+  inline KeyEvent decodeKey(const std::span<const int> chars)
   {
-    int chr = 0;
-    int hit = termUtils::kbHit();
-    std::vector<int> chars;
-    KeyEvent k;
-
-    while (hit > 0)
+    if (chars.empty())
     {
-#ifdef _WIN32
+      return KeyEvent();
+    }
+    const int last = chars.back();
+    // Printable ASCII keys carry their character too
+    auto ascii = [&chars, last](KeyEvent key)
+    {
+      if (chars.size() == 1 && last >= 0x20 && last < 0x7F)
+      {
+	key.codepoint = static_cast<char32_t>(last);
+	key.bytes[0] = static_cast<char>(last);
+	key.length = 1;
+      }
+      return key;
+    };
 
-      chr = _getch();
+    const Key code = termUtils::getKeyCode(chars);
+    if (code != Key::Unknown)
+    {
+      return ascii(KeyEvent(code, last,
+			    last >= 'A' && last <= 'Z' && chars.size() == 1 ? modifier::SHIFT : modifier::NONE));
+    }
 
-      switch (chr)
+    const int first = chars[0];
+    if (first >= 0x80 && first <= 0xFF && chars.size() == termUtils::utf8Length(static_cast<unsigned char>(first))
+	&& chars.size() > 1)
+    {
+      KeyEvent key(Key::Text, last);
+      for (std::size_t i = 0; i < chars.size(); ++i)
       {
-	case '\x09':  // TAB
-	  return KeyEvent(Key::Tab, 9);
-	case '\x0a':  // LF; falls-through
-	case '\x0d':  // CR
-	  return KeyEvent(Key::Enter, 13);
-	case '\x7f':  // DEL
-	  return KeyEvent(Key::Backspace, 8);
+	key.bytes[i] = static_cast<char>(chars[i]);
       }
-
-      chars.emplace_back(chr);
-      if (chr == 0 || chr == 224)
+      if (termUtils::validUtf8(key.bytes, chars.size()))
       {
-	chr = _getch();
-	chars.emplace_back(chr);
+	char32_t cp = static_cast<char32_t>(first & (0x7F >> chars.size()));
+	for (std::size_t i = 1; i < chars.size(); ++i)
+	{
+	  cp = (cp << 6) | static_cast<char32_t>(chars[i] & 0x3F);
+	}
+	key.codepoint = cp;
+	key.length = static_cast<unsigned char>(chars.size());
+	return key;
       }
-
-#endif
-#ifdef __linux__
-        chr = std::getchar();
-        chars.emplace_back(chr);
-#endif
-
-      hit--;
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    return KeyEvent(termUtils::getKeyCode(chars), chr);
-  }
-
-  void setEchoOn()
-  {
-#ifdef __linux__
-    termios term = termUtils::savedTerm;
-    tcsetattr(STDIN_FILENO, TCSANOW, &term);
-#endif
+    if (chars.size() == 1 && last == 13)
+    {
+      // Enter gives CR as ICRNL is off, see setEchoOff()
+      return KeyEvent(Key::Enter, last);
+    }
+    if (chars.size() == 1 && last >= 1 && last <= 26)
+    {
+      return KeyEvent(static_cast<Key>(static_cast<int>(Key::A) + last - 1), last, modifier::CTRL);
+    }
+    if (chars.size() == 2 && chars[0] == 27)
+    {
+      KeyEvent key = decodeKey(std::span<const int>(&last, 1));
+      key.modifiers |= modifier::ALT;
+      return key;
+    }
+    if (chars.size() > 3 && chars[0] == 27 && chars[1] == '[')
+    {
+      // CSI params;modifiers final, the modifier parameter is 1 + flags
+      const auto semicolon = std::find(chars.begin(), chars.end(), ';');
+      if (semicolon != chars.end())
+      {
+	int flags = 0;
+	for (auto it = semicolon + 1; it + 1 < chars.end() && *it >= '0' && *it <= '9'; ++it)
+	{
+	  flags = flags * 10 + (*it - '0');
+	}
+	// Without the modifier parameter, e.g. ESC [ 1 ; 5 A is ESC [ A
+	int plain[8];
+	std::size_t size = static_cast<std::size_t>(semicolon - chars.begin());
+	if (size >= std::size(plain))
+	{
+	  return ascii(KeyEvent(code, last));
+	}
+	std::copy(chars.begin(), semicolon, plain);
+	if (size == 3 && plain[2] == '1' && last != '~')
+	{
+	  --size;
+	}
+	plain[size++] = last;
+	const Key base = termUtils::getKeyCode(std::span<const int>(plain, size));
+	if (base != Key::Unknown && flags > 1)
+	{
+	  return KeyEvent(base, last, (flags - 1) & (modifier::SHIFT | modifier::ALT | modifier::CTRL));
+	}
+      }
+    }
+    return ascii(KeyEvent(code, last));
   }
 
-  void setEchoOff()
+  /** @brief Key event of the bytes of one key press, see above */
+  inline KeyEvent decodeKey(const std::vector<int>& chars)
   {
-#ifdef __linux__
-    termios term = termUtils::savedTerm;
-    term.c_lflag &= ~(termUtils::TERM_FLAGS);
-    term.c_cc[VMIN] = 1;
-    term.c_cc[VTIME] = 0;
-
-    tcsetattr(STDIN_FILENO, TCSANOW, &term);
-#endif
+    return decodeKey(std::span<const int>(chars));
   }
 
   /**
-   * @brief Console initialisation and save state
+   * @brief Check if a key is pressed.
+   * @return True if the key is pressed, false otherwise
    */
-  void initConsole()
-  {
-#ifdef __linux__
-    tcgetattr(STDIN_FILENO, &termUtils::savedTerm);
-    setEchoOff();
-#endif
-
-#ifdef _WIN32
-    DWORD outMode = 0;
-    DWORD inMode = 0;
-
-    termUtils::stdoutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-    termUtils::stdinHandle = GetStdHandle(STD_INPUT_HANDLE);
-
-    if (termUtils::stdoutHandle == INVALID_HANDLE_VALUE
-	|| termUtils::stdinHandle == INVALID_HANDLE_VALUE)
-    {
-      exit(GetLastError());
-    }
-
-    if (!GetConsoleMode(termUtils::stdoutHandle, &outMode)
-	|| !GetConsoleMode(termUtils::stdinHandle, &inMode))
-    {
-      exit(GetLastError());
-    }
-
-    termUtils::outModeInit = outMode;
-    termUtils::inModeInit = inMode;
-
-    // Enable ANSI escape codes
-    outMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
+  TERM_DECL bool isKeyPressed();
 
-    // Set stdin as no echo and unbuffered
-    inMode &= ~(ENABLE_ECHO_INPUT | ENABLE_LINE_INPUT);
+  /**
+   * @brief Get key presses
+   * @return Key with code and value
+   */
+  TERM_DECL KeyEvent keyPress();
 
-    if (!SetConsoleMode(termUtils::stdoutHandle, outMode)
-	|| !SetConsoleMode(termUtils::stdinHandle, inMode))
-    {
-      exit(GetLastError());
-    }
+  TERM_DECL void setEchoOn();
 
-    GetCurrentConsoleFontEx(termUtils::stdoutHandle, false, &termUtils::cfiOld);
+  TERM_DECL void setEchoOff();
 
-    CONSOLE_FONT_INFOEX cfi = { sizeof(CONSOLE_FONT_INFOEX) };
-    cfi.nFont = 0;
-    cfi.dwFontSize.X = 0;  // Width of each character in the font
-    cfi.dwFontSize.Y = 18; // Height
-    cfi.FontFamily = FF_DONTCARE;
-    cfi.FontWeight = FW_NORMAL;
-    std::wcscpy(cfi.FaceName, L"Cascadia Mono"); // Choose your font
-    SetCurrentConsoleFontEx(GetStdHandle(STD_OUTPUT_HANDLE), FALSE, &cfi);
-    // SetConsoleOutputCP(CP_UTF8);
-    SetConsoleOutputCP(65001);
-    SetConsoleCP(65001);
-#endif
-  }
+  /**
+   * @brief Console initialisation and save state
+   */
+  TERM_DECL void initConsole();
 
   /**
    * @brief Restore saved console
    */
-  void restoreConsole(void)
-  {
-    std::cout << RESET << std::flush;
-
-#ifdef _WIN32
-    // Reset console mode
-    if (!SetConsoleMode(termUtils::stdoutHandle, termUtils::outModeInit)
-	|| !SetConsoleMode(termUtils::stdinHandle, termUtils::inModeInit))
-    {
-      exit(GetLastError());
-    }
-    SetCurrentConsoleFontEx(GetStdHandle(STD_OUTPUT_HANDLE), FALSE,
-			    &termUtils::cfiOld);
-#endif
-#ifdef __linux__
-    tcsetattr(STDIN_FILENO, TCSANOW, &termUtils::savedTerm);
-#endif
-  }
+  TERM_DECL void restoreConsole(void);
 
   /**
    * @brief Save current screen
@@ -293,8 +293,8 @@ namespace term
    * @param os outbut. Default is std::cout
    * @param flush true if flushes the output immediadtly. Default is true
    */
-  void saveScreen(std::ostream& os = std::cout, const bool flush = true) {
-    os << "\x1b[?1049h" << "\x1b[?47h";
+  inline void saveScreen(std::ostream& os = defaultOutput(), const bool flush = true) {
+    os << capabilities().enterCaMode;
     if (flush)
     {
       os << std::flush;
@@ -307,8 +307,8 @@ namespace term
    * @param os outbut. Default is std::cout
    * @param flush true if flushes the output immediadtly. Default is true
    */
-  void restoreScreen(std::ostream& os = std::cout, const bool flush = true) {
-    os << "\x1b[?47l" << "\x1b[?1049l";
+  inline void restoreScreen(std::ostream& os = defaultOutput(), const bool flush = true) {
+    os << capabilities().exitCaMode;
     if (flush)
     {
       os << std::flush;
@@ -318,19 +318,19 @@ namespace term
   namespace clear
   {
     /** @brief Clear all the line code */
-    constexpr std::string_view LINE("\x1b[2K");
+    inline constexpr std::string_view LINE("\x1b[2K");
     /** @brief Clear line to end of line code */
-    constexpr std::string_view LINE_TO_RIGHT("\x1b[0K");
+    inline constexpr std::string_view LINE_TO_RIGHT("\x1b[0K");
     /** @brief Clear line to start of line code */
-    constexpr std::string_view LINE_TO_LEFT("\x1b[1K");
+    inline constexpr std::string_view LINE_TO_LEFT("\x1b[1K");
     /** @brief Clear screen code */
-    constexpr std::string_view SCREEN("\x1b[J");
+    inline constexpr std::string_view SCREEN("\x1b[J");
     /** @brief Clear all screen code */
-    constexpr std::string_view ALL_SCREEN("\x1b[2J");
+    inline constexpr std::string_view ALL_SCREEN("\x1b[2J");
     /** @brief Clear screen from cursor to bottom */
-    constexpr std::string_view SCREEN_TO_BOTTOM("\x1b[0J");
+    inline constexpr std::string_view SCREEN_TO_BOTTOM("\x1b[0J");
     /** @brief Clear screen from cursor to top */
-    constexpr std::string_view SCREEN_TO_TOP("\x1b[1J");
+    inline constexpr std::string_view SCREEN_TO_TOP("\x1b[1J");
 
     /**
      * @brief Clear line from cursor position
@@ -338,9 +338,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void line(std::ostream& os = std::cout, const bool flush = true)
+    inline void line(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      std::cout << LINE;
+      os << LINE;
       if (flush)
       {
 	os << std::flush;
@@ -353,9 +353,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void lineToRight(std::ostream& os = std::cout, const bool flush = true)
+    inline void lineToRight(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      std::cout << LINE_TO_RIGHT;
+      os << termUtils::sequence(capabilities().clearEol, LINE_TO_RIGHT);
       if (flush)
       {
 	os << std::flush;
@@ -368,9 +368,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void lineToLeft(std::ostream& os = std::cout, const bool flush = true)
+    inline void lineToLeft(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      std::cout << LINE_TO_LEFT;
+      os << termUtils::sequence(capabilities().clearBol, LINE_TO_LEFT);
       if (flush)
       {
 	os << std::flush;
@@ -383,9 +383,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void screen(std::ostream& os = std::cout, const bool flush = true)
+    inline void screen(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      std::cout << SCREEN;
+      os << termUtils::sequence(capabilities().clearEos, SCREEN);
       if (flush)
       {
 	os << std::flush;
@@ -398,9 +398,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void allScreen(std::ostream& os = std::cout, const bool flush = true)
+    inline void allScreen(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      std::cout << ALL_SCREEN;
+      os << ALL_SCREEN;
       if (flush)
       {
 	os << std::flush;
@@ -413,9 +413,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void screenToBottom(std::ostream& os = std::cout, const bool flush = true)
+    inline void screenToBottom(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      std::cout << SCREEN_TO_BOTTOM;
+      os << SCREEN_TO_BOTTOM;
       if (flush)
       {
 	os << std::flush;
@@ -428,9 +428,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void screenToTop(std::ostream& os = std::cout, const bool flush = true)
+    inline void screenToTop(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      std::cout << SCREEN_TO_TOP;
+      os << SCREEN_TO_TOP;
       if (flush)
       {
 	os << std::flush;
@@ -442,56 +442,52 @@ namespace term
   namespace color
   {
 
-    constexpr std::string_view RESET("\x1b[0m");
+    inline constexpr std::string_view RESET("\x1b[0m");
     /** @brief Black background */
-    constexpr std::string_view BG_BLACK("\x1b[40;1m");
+    inline constexpr std::string_view BG_BLACK("\x1b[40;1m");
     /** @brief Red background */
-    constexpr std::string_view BG_RED("\x1b[41;1m");
+    inline constexpr std::string_view BG_RED("\x1b[41;1m");
     /** @brief Green background */
-    constexpr std::string_view BG_GREEN("\x1b[42;1m");
+    inline constexpr std::string_view BG_GREEN("\x1b[42;1m");
     /** @brief Yellow background */
-    constexpr std::string_view BG_YELLOW("\x1b[43;1m");
+    inline constexpr std::string_view BG_YELLOW("\x1b[43;1m");
     /** @brief Blue background */
-    constexpr std::string_view BG_BLUE("\x1b[44;1m");
+    inline constexpr std::string_view BG_BLUE("\x1b[44;1m");
     /** @brief Magenta background */
-    constexpr std::string_view BG_MAGENTA("\x1b[45;1m");
+    inline constexpr std::string_view BG_MAGENTA("\x1b[45;1m");
     /** @brief Cyan background */
-    constexpr std::string_view BG_CYAN("\x1b[46;1m");
+    inline constexpr std::string_view BG_CYAN("\x1b[46;1m");
     /** @brief White background */
-    constexpr std::string_view BG_WHITE("\x1b[47;1m");
+    inline constexpr std::string_view BG_WHITE("\x1b[47;1m");
 
     /** @brief Black foreground */
-    constexpr std::string_view FG_BLACK("\x1b[30;1m");
+    inline constexpr std::string_view FG_BLACK("\x1b[30;1m");
     /** @brief Red foreground */
-    constexpr std::string_view FG_RED("\x1b[31;1m");
+    inline constexpr std::string_view FG_RED("\x1b[31;1m");
     /** @brief Green foreground */
-    constexpr std::string_view FG_GREEN("\x1b[32;1m");
+    inline constexpr std::string_view FG_GREEN("\x1b[32;1m");
     /** @brief Yellow foreground */
-    constexpr std::string_view FG_YELLOW("\x1b[33;1m");
+    inline constexpr std::string_view FG_YELLOW("\x1b[33;1m");
     /** @brief Blue foreground */
-    constexpr std::string_view FG_BLUE("\x1b[34;1m");
+    inline constexpr std::string_view FG_BLUE("\x1b[34;1m");
     /** @brief Magenta foreground */
-    constexpr std::string_view FG_MAGENTA("\x1b[35;1m");
+    inline constexpr std::string_view FG_MAGENTA("\x1b[35;1m");
     /** @brief Cyan foreground */
-    constexpr std::string_view FG_CYAN("\x1b[36;1m");
+    inline constexpr std::string_view FG_CYAN("\x1b[36;1m");
     /** @brief White foreground */
-    constexpr std::string_view FG_WHITE("\x1b[37;1m");
+    inline constexpr std::string_view FG_WHITE("\x1b[37;1m");
     /** @brief Foreground color from 0 to 254 */
     template<unsigned char color>
-      constexpr std::string FG("\x1b[38;5;" + std::to_string(color) + "m");
+      inline constexpr std::string_view FG = termUtils::CSI<termUtils::csi("38;5;", { color }, 'm')>.view();
     /** @brief Background color from 0 to 254 */
     template<unsigned char color>
-      constexpr std::string BG("\x1b[48;5;" + std::to_string(color) + "m");
+      inline constexpr std::string_view BG = termUtils::CSI<termUtils::csi("48;5;", { color }, 'm')>.view();
     /** @brief Backgrouund RGB color from 0 to 254 for each componant*/
     template<unsigned char r, unsigned char g, unsigned char b>
-      constexpr std::string BG_RGB(
-	  "\x1B[48;2;" + std::to_string(r) + ";" + std::to_string(g) + ";"
-	      + std::to_string(b) + "m");
+      inline constexpr std::string_view BG_RGB = termUtils::CSI<termUtils::csi("48;2;", { r, g, b }, 'm')>.view();
     /** @brief Foregrouund RGB color from 0 to 254 for each componant*/
     template<unsigned char r, unsigned char g, unsigned char b>
-      constexpr std::string FG_RGB(
-	  "\x1B[38;2;" + std::to_string(r) + ";" + std::to_string(g) + ";"
-	      + std::to_string(b) + "m");
+      inline constexpr std::string_view FG_RGB = termUtils::CSI<termUtils::csi("38;2;", { r, g, b }, 'm')>.view();
 
     /**
      * @brief Set foreground color
@@ -500,10 +496,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void fg(const unsigned char color, std::ostream& os = std::cout, const bool flush =
+    inline void fg(const unsigned char color, std::ostream& os = defaultOutput(), const bool flush =
 		true)
     {
-      os << "\x1b[38;5;" + std::to_string(color) + "m";
+      termUtils::writeCsi(os, "38;5;", { color }, 'm');
       if (flush)
       {
 	os << std::flush;
@@ -517,10 +513,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void bg(const unsigned char color, std::ostream& os = std::cout, const bool flush =
+    inline void bg(const unsigned char color, std::ostream& os = defaultOutput(), const bool flush =
 		true)
     {
-      os << "\x1b[48;5;" + std::to_string(color) + "m";
+      termUtils::writeCsi(os, "48;5;", { color }, 'm');
       if (flush)
       {
 	os << std::flush;
@@ -534,12 +530,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void fgRgb(const unsigned char r, const unsigned char g, const unsigned char b, std::ostream& os =
-		   std::cout, const bool flush = true)
+    inline void fgRgb(const unsigned char r, const unsigned char g, const unsigned char b, std::ostream& os =
+		   defaultOutput(), const bool flush = true)
     {
-      os
-	  << "\x1B[38;2;" + std::to_string(r) + ";" + std::to_string(g) + ";"
-	      + std::to_string(b) + "m";
+      termUtils::writeCsi(os, "38;2;", { r, g, b }, 'm');
       if (flush)
       {
 	os << std::flush;
@@ -553,12 +547,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void bgRgb(const unsigned char r, const unsigned char g, const unsigned char b, std::ostream& os =
-		   std::cout, const bool flush = true)
+    inline void bgRgb(const unsigned char r, const unsigned char g, const unsigned char b, std::ostream& os =
+		   defaultOutput(), const bool flush = true)
     {
-      os
-	  << "\x1B[48;2;" + std::to_string(r) + ";" + std::to_string(g) + ";"
-	      + std::to_string(b) + "m";
+      termUtils::writeCsi(os, "48;2;", { r, g, b }, 'm');
       if (flush)
       {
 	os << std::flush;
@@ -571,7 +563,7 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void reset(std::ostream& os = std::cout, const bool flush = true)
+    inline void reset(std::ostream& os = defaultOutput(), const bool flush = true)
     {
       os << RESET;
       if (flush)
@@ -585,34 +577,33 @@ namespace term
   namespace cursor
   {
     /** @brief Set cursor on */
-    constexpr std::string_view ON("\x1b[?25h");
+    inline constexpr std::string_view ON("\x1b[?25h");
     /** @brief Set cursor off */
-    constexpr std::string_view OFF("\x1b[?25l");
+    inline constexpr std::string_view OFF("\x1b[?25l");
     /** @brief Move cursor to row and col */
     template<unsigned int row, unsigned int col>
-      const std::string MOVE(
-	  "\x1b[" + std::to_string(row) + ";" + std::to_string(col) + "H");
+      inline constexpr std::string_view MOVE = termUtils::CSI<termUtils::csi("", { row, col }, 'H')>.view();
     /** @brief Move cursor up */
     template<unsigned int offset = 1>
-      constexpr std::string MOVE_UP("\x1b[" + std::to_string(offset) + "A");
+      inline constexpr std::string_view MOVE_UP = termUtils::CSI<termUtils::csi("", { offset }, 'A')>.view();
     /** @brief Move cursor down */
     template<unsigned int offset = 1>
-      constexpr std::string MOVE_DOWN("\x1b[" + std::to_string(offset) + "B");
+      inline constexpr std::string_view MOVE_DOWN = termUtils::CSI<termUtils::csi("", { offset }, 'B')>.view();
     /** @brief Move cursor right */
     template<unsigned int offset = 1>
-      constexpr std::string MOVE_RIGHT("\x1b[" + std::to_string(offset) + "C");
+      inline constexpr std::string_view MOVE_RIGHT = termUtils::CSI<termUtils::csi("", { offset }, 'C')>.view();
     /** @brief Move cursor left */
     template<unsigned int offset = 1>
-      constexpr std::string MOVE_LEFT("\x1b[" + std::to_string(offset) + "D");
+      inline constexpr std::string_view MOVE_LEFT = termUtils::CSI<termUtils::csi("", { offset }, 'D')>.view();
     /** @brief Move cursor tol column col */
     template<unsigned int col>
-      constexpr std::string MOVE_TO_COL("\x1b[" + std::to_string(col) + "G");
+      inline constexpr std::string_view MOVE_TO_COL = termUtils::CSI<termUtils::csi("", { col }, 'G')>.view();
     /** @brief Move cursor to top left corner */
-    const std::string_view ORIGIN("\x1b[H");
+    inline constexpr std::string_view ORIGIN("\x1b[H");
     /** @brief Save cursor position */
-    const std::string_view SAVE("\x1b[s");
+    inline constexpr std::string_view SAVE("\x1b[s");
     /** @brief Restore a saved cursor position */
-    const std::string_view RESTORE("\x1b[u");
+    inline constexpr std::string_view RESTORE("\x1b[u");
 
     /**
      * @brief Show cursor
@@ -620,9 +611,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void on(std::ostream& os = std::cout, const bool flush = true)
+    inline void on(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      os << ON;
+      os << termUtils::sequence(capabilities().cursorNormal, ON);
       if (flush)
       {
 	os << std::flush;
@@ -635,9 +626,9 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void off(std::ostream& os = std::cout, const bool flush = true)
+    inline void off(std::ostream& os = defaultOutput(), const bool flush = true)
     {
-      os << OFF;
+      os << termUtils::sequence(capabilities().cursorInvisible, OFF);
       if (flush)
       {
 	os << std::flush;
@@ -652,10 +643,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void move(const int row, const int col, std::ostream& os = std::cout, const bool flush =
+    inline void move(const int row, const int col, std::ostream& os = defaultOutput(), const bool flush =
 		  true)
     {
-      os << "\x1b[" + std::to_string(row) + ";" + std::to_string(col) + "H";
+      termUtils::writeCsi(os, "", { row, col }, 'H');
       if (flush)
       {
 	os << std::flush;
@@ -669,10 +660,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void moveUp(const int offset = 1, std::ostream& os = std::cout, const bool flush =
+    inline void moveUp(const int offset = 1, std::ostream& os = defaultOutput(), const bool flush =
 		    true)
     {
-      os << "\x1b[" + std::to_string(offset) + "A";
+      termUtils::writeCsi(os, "", { offset }, 'A');
       if (flush)
       {
 	os << std::flush;
@@ -686,10 +677,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void moveDown(const int offset = 1, std::ostream& os = std::cout, const bool flush =
+    inline void moveDown(const int offset = 1, std::ostream& os = defaultOutput(), const bool flush =
 		      true)
     {
-      os << "\x1b[" + std::to_string(offset) + "B";
+      termUtils::writeCsi(os, "", { offset }, 'B');
       if (flush)
       {
 	os << std::flush;
@@ -703,10 +694,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void moveRight(const int offset = 1, std::ostream& os = std::cout, const bool flush =
+    inline void moveRight(const int offset = 1, std::ostream& os = defaultOutput(), const bool flush =
 		       true)
     {
-      os << "\x1b[" + std::to_string(offset) + "C";
+      termUtils::writeCsi(os, "", { offset }, 'C');
       if (flush)
       {
 	os << std::flush;
@@ -720,10 +711,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void moveLeft(const int offset = 1, std::ostream& os = std::cout, const bool flush =
+    inline void moveLeft(const int offset = 1, std::ostream& os = defaultOutput(), const bool flush =
 		      true)
     {
-      os << "\x1b[" + std::to_string(offset) + "D";
+      termUtils::writeCsi(os, "", { offset }, 'D');
       if (flush)
       {
 	os << std::flush;
@@ -737,10 +728,10 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void moveToCol(const int col, std::ostream& os = std::cout, const bool flush =
+    inline void moveToCol(const int col, std::ostream& os = defaultOutput(), const bool flush =
 		       true)
     {
-      os << "\x1b[" + std::to_string(col) + "G";
+      termUtils::writeCsi(os, "", { col }, 'G');
       if (flush)
       {
 	os << std::flush;
@@ -753,7 +744,7 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void origin(std::ostream& os = std::cout, const bool flush = true)
+    inline void origin(std::ostream& os = defaultOutput(), const bool flush = true)
     {
       os << ORIGIN;
       if (flush)
@@ -768,7 +759,7 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void save(std::ostream& os = std::cout, const bool flush = true)
+    inline void save(std::ostream& os = defaultOutput(), const bool flush = true)
     {
       os << SAVE;
       if (flush)
@@ -783,7 +774,7 @@ namespace term
      * @param os outbut. Default is std::cout
      * @param flush true if flushes the output immediadtly. Default is true
      */
-    void restore(std::ostream& os = std::cout, const bool flush = true)
+    inline void restore(std::ostream& os = defaultOutput(), const bool flush = true)
     {
       os << RESTORE;
       if (flush)
@@ -796,54 +787,27 @@ namespace term
      * @brief Get position of cursor
      * @return @Pos Cursor's position
      */
-    Pos position()
-    {
-      std::cout << "\x1b[6n" << std::flush;
-      char buff[32] = { 0 };
-      int indx = 0;
-      while (true)
-      {
-	int cc = getchar();
-	buff[indx] = static_cast<char>(cc);
-	indx++;
-	if (cc == 'R')
-	{
-	  buff[indx + 1] = '\0';
-	  break;
-	}
-      }
-      indx = 0;
-      std::string str = "";
-      char chr = buff[++indx];
-      while (chr != 'R')
-      {
-	if (std::find(termUtils::CHARS.begin(), termUtils::CHARS.end(), chr)
-	    != termUtils::CHARS.end())
-	{
-	  str += chr;
-	}
-	chr = buff[++indx];
-      }
-      //        tcsetattr(0, TCSANOW, &curTerm);
-      std::size_t pos = str.find(";");
-      return Pos(std::stoi(str.substr(0, pos)), std::stoi(str.substr(pos + 1)));
-    }
+    TERM_DECL Pos position();
   }
 
   namespace style
   {
     /** @brief Bright code */
-    constexpr std::string_view BRIGHT("\x1b[1m");
+    inline constexpr std::string_view BRIGHT("\x1b[1m");
     /** @brief Dim code */
-    constexpr std::string_view DIM("\x1b[2m");
+    inline constexpr std::string_view DIM("\x1b[2m");
     /** @brief Underscore code */
-    constexpr std::string_view UNDERSCORE("\x1b[4m");
+    inline constexpr std::string_view UNDERSCORE("\x1b[4m");
     /** @brief Blink code */
-    constexpr std::string_view BLINK("\x1b[5m");
+    inline constexpr std::string_view BLINK("\x1b[5m");
     /** @brief Reverse code */
-    constexpr std::string_view REVERSE("\x1b[7m");
+    inline constexpr std::string_view REVERSE("\x1b[7m");
   }
 
 }
 
+#ifndef TERM_COMPILED
+#include "console.hpp"
+#endif
+
 #endif // TERM_HPP
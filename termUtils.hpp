@@ -1,75 +1,194 @@
 #ifndef TERMUTILS_HPP
 #define TERMUTILS_HPP
 
+#include <initializer_list>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
-#ifdef __linux__
-#include <termios.h>
-#include <unistd.h>
-#endif
-
-#ifdef _WIN32
-#include <windows.h>
-#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
-#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
-#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
 #endif
 
 #include "keys.hpp"
 
 namespace termUtils
 {
-#ifdef __linux__
-//static constexpr tcflag_t TERM_FLAGS = ICANON | ECHO | ISIG | IEXTEN | ICRNL | IXON | IUTF8;
-static constexpr tcflag_t TERM_FLAGS = ICANON | ECHO | ISIG | IEXTEN | ICRNL | IXON | IUTF8;
-#endif
-static const std::vector<char> CHARS({ '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', ';' });
+inline const std::vector<char> CHARS({ '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', ';' });
 
-#ifdef _WIN32
-//static constexpr unsigned char ENABLE_VIRTUAL_TERMINAL_PROCESSING = 0x0004;
-static HANDLE stdoutHandle;
-static HANDLE stdinHandle;
-static DWORD outModeInit;
-static DWORD inModeInit;
-static CONSOLE_FONT_INFOEX cfiOld = { sizeof(CONSOLE_FONT_INFOEX) };
-#endif
+/**
+ * @brief Length of a UTF-8 sequence from its first byte
+ * @return 1 to 4, 1 for an invalid first byte
+ */
+inline std::size_t utf8Length(const unsigned char lead)
+{
+    if(lead >= 0xF0 && lead <= 0xF4) {
+        return 4;
+    }
+    if(lead >= 0xE0 && lead <= 0xEF) {
+        return 3;
+    }
+    if(lead >= 0xC2 && lead <= 0xDF) {
+        return 2;
+    }
+    return 1;
+}
 
-#ifdef __linux__
-termios savedTerm;
-static constexpr int STDIN = 0;
-static bool initialized = false;
-#endif
+/**
+ * @brief Length of the first key in input bytes
+ *
+ * Escape sequences (CSI, SS3, Alt+key) and UTF-8 sequences make one key,
+ * any other byte is a key on its own. A lone escape at the end of the input
+ * is the Escape key.
+ *
+ * @return Number of bytes, 0 if the input ends inside a sequence
+ */
+inline std::size_t keyLength(const std::string& input, const std::size_t pos)
+{
+    if(input[pos] != '\x1b') {
+        const std::size_t len = utf8Length(static_cast<unsigned char>(input[pos]));
+        return pos + len <= input.size() ? len : 0;
+    }
+    if(pos + 1 == input.size()) {
+        return 1;
+    }
+    const char kind = input[pos + 1];
+    if(kind == 'O') {
+        return pos + 2 < input.size() ? 3 : 0;
+    }
+    if(kind != '[') {
+        return 2;
+    }
+    for(std::size_t i = pos + 2; i < input.size(); ++i) {
+        if(input[i] >= 0x40 && input[i] <= 0x7E) {
+            return i + 1 - pos;
+        }
+    }
+    return 0;
+}
 
 /**
- * @brief Get key pressed
- * @return bool if a key was pressed or noti
+ * @brief Check UTF-8 text: no overlong form, surrogate or code point above
+ * U+10FFFF. ASCII runs are skipped 16 bytes at a time with SSE2
  */
-int kbHit()
+inline bool validUtf8(const char* data, const std::size_t size)
 {
-#ifdef _WIN32
-    return _kbhit();
+    std::size_t i = 0;
+    while(i < size) {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+        if(c < 0x80) {
+            ++i;
+#ifdef __SSE2__
+            while(i + 16 <= size
+                  && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))) == 0) {
+                i += 16;
+            }
 #endif
+            continue;
+        }
 
-#ifdef __linux__
-    if(!initialized) {
-        // Use termios to turn off line buffering
-        termios term;
-        tcgetattr(STDIN, &term);
-        term.c_lflag &= ~ICANON;
-        tcsetattr(STDIN, TCSANOW, &term);
-        setbuf(stdin, NULL);
-        initialized = true;
+        const std::size_t len = utf8Length(c);
+        if(len == 1 || i + len > size) {
+            return false;
+        }
+        // Range of the second byte, narrower after E0, ED, F0 and F4
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if(c == 0xE0) {
+            low = 0xA0;
+        } else if(c == 0xED) {
+            high = 0x9F;
+        } else if(c == 0xF0) {
+            low = 0x90;
+        } else if(c == 0xF4) {
+            high = 0x8F;
+        }
+        const unsigned char second = static_cast<unsigned char>(data[i + 1]);
+        if(second < low || second > high) {
+            return false;
+        }
+        for(std::size_t n = 2; n < len; ++n) {
+            if((static_cast<unsigned char>(data[i + n]) & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += len;
     }
+    return true;
+}
 
-    int bytesWaiting;
-    ioctl(STDIN, FIONREAD, &bytesWaiting);
-    return bytesWaiting;
-#endif
+/** @brief Escape sequence formatted without allocation, see csi() */
+struct CsiSequence {
+    char data[64] = {};
+    std::size_t size = 0;
+
+    constexpr std::string_view view() const
+    {
+        return std::string_view(data, size);
+    }
+};
+
+/**
+ * @brief Format a CSI sequence with numeric parameters, at compile time or
+ * on the stack
+ *
+ * @param prefix parameters written as is after ESC [, e.g. "38;5;"
+ * @param params numbers separated by ';', at most 4
+ * @param final final byte of the sequence
+ */
+constexpr CsiSequence csi(const std::string_view prefix, const std::initializer_list<int> params, const char final)
+{
+    CsiSequence seq;
+    seq.data[seq.size++] = '\x1b';
+    seq.data[seq.size++] = '[';
+    for(std::size_t i = 0; i < prefix.size() && i < 16; ++i) {
+        seq.data[seq.size++] = prefix[i];
+    }
+    bool first = true;
+    for(const int param : params) {
+        if(seq.size + 13 > sizeof(seq.data)) {
+            break;
+        }
+        if(!first) {
+            seq.data[seq.size++] = ';';
+        }
+        first = false;
+        long long value = param;
+        if(value < 0) {
+            seq.data[seq.size++] = '-';
+            value = -value;
+        }
+        char digits[12];
+        std::size_t n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while(value > 0);
+        while(n > 0) {
+            seq.data[seq.size++] = digits[--n];
+        }
+    }
+    seq.data[seq.size++] = final;
+    return seq;
+}
+
+/** @brief Storage of a sequence built at compile time, for string views on it */
+template <CsiSequence SEQUENCE>
+inline constexpr CsiSequence CSI = SEQUENCE;
+
+/** @brief Write a CSI sequence with numeric parameters, see csi() */
+inline void writeCsi(std::ostream& os, const std::string_view prefix, const std::initializer_list<int> params,
+                     const char final)
+{
+    const CsiSequence seq = csi(prefix, params, final);
+    os.write(seq.data, static_cast<std::streamsize>(seq.size));
 }
 
 /** @brief Key code when key pressed */
-term::Key getKeyCode(const std::vector<int>& buf)
+inline term::Key getKeyCode(const std::span<const int> buf)
 {
     if(buf.empty()) {
         return term::Key::None;
@@ -241,6 +360,18 @@ term::Key getKeyCode(const std::vector<int>& buf)
                 return term::Key::Right;
             case 75:
                 return term::Key::Left;
+            case 71:
+                return term::Key::Home;
+            case 79:
+                return term::Key::End;
+            case 73:
+                return term::Key::PageUp;
+            case 81:
+                return term::Key::PageDown;
+            case 82:
+                return term::Key::Insert;
+            case 83:
+                return term::Key::Delete;
             case 134:
                 return term::Key::F12;
             }
@@ -259,9 +390,17 @@ term::Key getKeyCode(const std::vector<int>& buf)
                     return term::Key::Right;
                 case 68:
                     return term::Key::Left;
+                case 72:
+                    return term::Key::Home;
+                case 70:
+                    return term::Key::End;
                 }
             } else if(buf[1] == 79) {
                 switch(buf[2]) {
+                case 72:
+                    return term::Key::Home;
+                case 70:
+                    return term::Key::End;
                 case 80:
                     return term::Key::F1;
                 case 81:
@@ -273,6 +412,28 @@ term::Key getKeyCode(const std::vector<int>& buf)
                 }
             }
         }
+#endif
+    } else if(buf.size() == 4) {
+#ifdef __linux__
+        // ESC [ n ~, 7 and 8 are Home and End of rxvt
+        if(buf[0] == 27 && buf[1] == 91 && buf[3] == 126) {
+            switch(buf[2]) {
+            case 49:
+            case 55:
+                return term::Key::Home;
+            case 50:
+                return term::Key::Insert;
+            case 51:
+                return term::Key::Delete;
+            case 52:
+            case 56:
+                return term::Key::End;
+            case 53:
+                return term::Key::PageUp;
+            case 54:
+                return term::Key::PageDown;
+            }
+        }
 #endif
     } else if(buf.size() == 5) {
 #ifdef __linux__
@@ -0,0 +1,402 @@
+#ifndef TERMINAL_HPP
+#define TERMINAL_HPP
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "capabilities.hpp"
+#include "cell.hpp"
+#include "output.hpp"
+#include "probe.hpp"
+#include "trace.hpp"
+
+namespace term
+{
+
+  /**
+   * @brief One terminal session on its own file descriptors
+   *
+   * Unlike the free functions, which drive the terminal of the process
+   * through stdin, stdout and global state, a Terminal carries its saved
+   * modes, size, capabilities, input and output buffers, so one process can
+   * serve many sessions, e.g. pty masters or network connections.
+   *
+   * Nothing blocks: register inputDescriptor() for reading and, while
+   * pending(), outputDescriptor() for writing in an epoll or poll loop,
+   * then call read() and flush(). Not thread safe, each session is driven
+   * by one thread at a time.
+   */
+  class Terminal
+  {
+    public:
+      using Clock = std::chrono::steady_clock;
+
+      /**
+       * @brief Bind a session to its descriptors, which it does not own
+       *
+       * @param in descriptor keys are read from
+       * @param out descriptor the screen is written to, may equal in
+       * @param caps features of the terminal. Default is the library profile
+       */
+      Terminal(const int in, const int out, const Capabilities& caps = term::capabilities())
+	  : in(in), caps(caps), out(out, this->caps)
+      {
+	inFlags = fcntl(in, F_GETFL);
+	if (inFlags >= 0)
+	{
+	  fcntl(in, F_SETFL, inFlags | O_NONBLOCK);
+	}
+	updateSize();
+      }
+
+      /**
+       * @brief Restore the modes changed by init() and the blocking mode
+       *
+       * Output still queued is dropped: to send it, call restore() and
+       * flush() until pending() is false before destroying the session.
+       */
+      ~Terminal()
+      {
+	restore();
+	if (inFlags >= 0)
+	{
+	  fcntl(in, F_SETFL, inFlags);
+	}
+      }
+
+      Terminal(const Terminal&) = delete;
+      Terminal& operator=(const Terminal&) = delete;
+
+      /**
+       * @brief Save the terminal modes and switch to non canonical mode
+       * without echo, like initConsole()
+       *
+       * Does nothing if the input is not a terminal, e.g. a socket whose
+       * peer handles the modes.
+       *
+       * @return False if the modes cannot be changed
+       */
+      bool init()
+      {
+	if (saved || !isatty(in))
+	{
+	  return true;
+	}
+	if (tcgetattr(in, &savedTerm) != 0)
+	{
+	  return false;
+	}
+	termios raw = savedTerm;
+	raw.c_lflag &= ~(RAW_FLAGS);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	saved = tcsetattr(in, TCSANOW, &raw) == 0;
+	return saved;
+      }
+
+      /**
+       * @brief Reset the attributes and restore the modes saved by init(),
+       * like restoreConsole()
+       *
+       * Does not block: the soft reset is queued after the output and
+       * written by flush(), see pending().
+       */
+      void restore()
+      {
+	if (!saved)
+	{
+	  return;
+	}
+	out.append(caps.softReset);
+	out.append(caps.exitAttributes);
+	tcsetattr(in, TCSANOW, &savedTerm);
+	saved = false;
+      }
+
+      /** @brief Descriptor to watch for reading */
+      int inputDescriptor() const
+      {
+	return in;
+      }
+
+      /** @brief Descriptor to watch for writing while pending() */
+      int outputDescriptor() const
+      {
+	return out.descriptor();
+      }
+
+      /** @brief Features of the terminal */
+      const Capabilities& capabilities() const
+      {
+	return caps;
+      }
+
+      /** @brief Change the features of the terminal, the next frame is a full redraw */
+      void setCapabilities(const Capabilities& c)
+      {
+	caps = c;
+	out.invalidate();
+      }
+
+      /** @brief Size of the terminal, see updateSize() and resize() */
+      const Size& size() const
+      {
+	return sz;
+      }
+
+      /**
+       * @brief Read the size of a terminal output, after SIGWINCH
+       *
+       * @return True if the size changed
+       */
+      bool updateSize()
+      {
+	winsize w;
+	if (ioctl(out.descriptor(), TIOCGWINSZ, &w) != 0 || w.ws_row == 0 || w.ws_col == 0)
+	{
+	  return false;
+	}
+	return resize(Size(w.ws_row, w.ws_col));
+      }
+
+      /**
+       * @brief Set the size, when the session reports it itself, e.g. an
+       * SSH window change request
+       *
+       * @return True if the size changed
+       */
+      bool resize(const Size& size)
+      {
+	if (size.rows == sz.rows && size.cols == sz.cols)
+	{
+	  return false;
+	}
+	sz = size;
+	frame.resize(size);
+	out.invalidate();
+	return true;
+      }
+
+      /**
+       * @brief Ask the terminal for its features, see probeTerminal()
+       *
+       * The replies are parsed by read() until the DA1 reply or expire()
+       * after the timeout, then probed() is true and capabilities() updated.
+       * Keys typed meanwhile are kept.
+       *
+       * @return False on a write error
+       */
+      bool probe(const std::chrono::milliseconds timeout = std::chrono::milliseconds(500))
+      {
+	probing = true;
+	probeDeadline = Clock::now() + timeout;
+	replies.clear();
+	return out.append(termUtils::PROBE_QUERIES);
+      }
+
+      /** @brief True once a probe got its replies */
+      bool probed() const
+      {
+	return caps.probed;
+      }
+
+      /** @brief Time a probe in progress ends, see expire() */
+      Clock::time_point deadline() const
+      {
+	return probing ? probeDeadline : Clock::time_point::max();
+      }
+
+      /** @brief End a probe whose deadline is reached */
+      void expire(const Clock::time_point now)
+      {
+	if (probing && now >= probeDeadline)
+	{
+	  endProbe(false);
+	}
+      }
+
+      /** @brief Cursor position reported by the last probe, from 1,1 */
+      const Pos& cursor() const
+      {
+	return cursorPos;
+      }
+
+      /**
+       * @brief Read the available input without blocking and decode keys
+       *
+       * @return False at end of input or on a read error: the session is over
+       */
+      bool read()
+      {
+	char buf[4096];
+	while (true)
+	{
+	  const ssize_t n = ::read(in, buf, sizeof(buf));
+	  if (n == 0)
+	  {
+	    return false;
+	  }
+	  if (n < 0)
+	  {
+	    if (errno == EINTR)
+	    {
+	      continue;
+	    }
+	    return errno == EAGAIN || errno == EWOULDBLOCK;
+	  }
+	  const std::string_view data(buf, static_cast<std::size_t>(n));
+	  if (probing)
+	  {
+	    replies.append(data);
+	    if (termUtils::parseProbe(replies, caps, cursorPos, unread, false))
+	    {
+	      endProbe(true);
+	    }
+	  }
+	  else
+	  {
+	    pendingInput.append(data);
+	    decode();
+	  }
+	}
+      }
+
+      /**
+       * @brief Take the next key read
+       *
+       * @param key set to the key
+       * @return False if no key is left
+       */
+      bool nextKey(KeyEvent& key)
+      {
+	if (keys.empty())
+	{
+	  return false;
+	}
+	key = keys.front();
+	keys.pop_front();
+	return true;
+      }
+
+      /** @brief Cells of the next frame, sized to the terminal */
+      CellBuffer& buffer()
+      {
+	return frame;
+      }
+
+      /**
+       * @brief Draw buffer() as the next frame, see Output::submit()
+       *
+       * @return False on a write error
+       */
+      bool present()
+      {
+	return out.submit(frame);
+      }
+
+      /**
+       * @brief Queue bytes which do not change the cells, e.g. mode changes
+       *
+       * @return False on a write error
+       */
+      bool write(const std::string_view bytes)
+      {
+	return out.append(bytes);
+      }
+
+      /**
+       * @brief Write queued output without blocking
+       *
+       * @return False on a write error
+       */
+      bool flush()
+      {
+	return out.flush();
+      }
+
+      /** @brief True while output is queued: wait until outputDescriptor() is writable, then flush() */
+      bool pending() const
+      {
+	return out.pending();
+      }
+
+      /** @brief Frame output of the session */
+      Output& output()
+      {
+	return out;
+      }
+
+    private:
+      // Local modes cleared in raw mode, as by setEchoOff()
+      static constexpr tcflag_t RAW_FLAGS = ICANON | ECHO | ISIG | IEXTEN | ICRNL | IXON | IUTF8;
+
+      int in;
+      int inFlags = -1;
+      termios savedTerm {};
+      bool saved = false;
+      Capabilities caps;
+      Output out;
+      Size sz;
+      CellBuffer frame;
+      // Input not decoded yet, ending inside a key
+      std::string pendingInput;
+      std::deque<KeyEvent> keys;
+      std::vector<int> chars;
+      // Probe in progress
+      bool probing = false;
+      Clock::time_point probeDeadline;
+      std::string replies;
+      std::string unread;
+      Pos cursorPos;
+
+      void endProbe(const bool answered)
+      {
+	termUtils::parseProbe(replies, caps, cursorPos, unread, true);
+	caps.probed = answered;
+	probing = false;
+	replies.clear();
+	pendingInput += unread;
+	unread.clear();
+	decode();
+      }
+
+      void decode()
+      {
+	std::size_t pos = 0;
+	while (pos < pendingInput.size())
+	{
+	  const std::size_t len = termUtils::keyLength(pendingInput, pos);
+	  if (len == 0)
+	  {
+	    break;
+	  }
+	  chars.clear();
+	  for (std::size_t i = pos; i < pos + len; ++i)
+	  {
+	    // As read by getchar(), decodeKey() expects bytes as unsigned
+	    chars.push_back(static_cast<unsigned char>(pendingInput[i]));
+	  }
+	  keys.push_back(decodeKey(chars));
+	  TERM_TRACE_INPUT();
+	  pos += len;
+	}
+	pendingInput.erase(0, pos);
+      }
+  };
+
+}
+
+#endif
+
+#endif // TERMINAL_HPP
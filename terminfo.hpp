@@ -0,0 +1,542 @@
+#ifndef TERMINFO_HPP
+#define TERMINFO_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "capabilities.hpp"
+
+namespace termUtils
+{
+
+#ifdef __linux__
+
+/** @brief Magic of compiled entries with 16 bit numbers */
+static constexpr int TERMINFO_MAGIC = 0432;
+/** @brief Magic of compiled entries with 32 bit numbers */
+static constexpr int TERMINFO_MAGIC32 = 01036;
+/** @brief Version of the capability cache format */
+static constexpr std::uint32_t CAPS_CACHE_VERSION = 2;
+
+// Indexes of the standard capabilities, in the order of term.h
+static constexpr int TI_AM = 1;
+static constexpr int TI_BCE = 28;
+static constexpr int TI_COLORS = 13;
+static constexpr struct
+{
+    int index;
+    std::string term::Capabilities::*member;
+} TI_STRINGS[] = {
+    { 3, &term::Capabilities::scrollRegion },
+    { 5, &term::Capabilities::clearScreen },
+    { 6, &term::Capabilities::clearEol },
+    { 7, &term::Capabilities::clearEos },
+    { 8, &term::Capabilities::columnAddress },
+    { 10, &term::Capabilities::cursorAddress },
+    { 13, &term::Capabilities::cursorInvisible },
+    { 16, &term::Capabilities::cursorNormal },
+    { 28, &term::Capabilities::enterCaMode },
+    { 37, &term::Capabilities::eraseChars },
+    { 39, &term::Capabilities::exitAttributes },
+    { 40, &term::Capabilities::exitCaMode },
+    { 111, &term::Capabilities::cursorLeft },
+    { 112, &term::Capabilities::cursorRight },
+    { 121, &term::Capabilities::repeatChar },
+    { 123, &term::Capabilities::softReset },
+    { 126, &term::Capabilities::restoreCursor },
+    { 128, &term::Capabilities::saveCursor },
+    { 269, &term::Capabilities::clearBol },
+};
+
+/** @brief Strings stored in the capability cache, in order */
+static constexpr std::string term::Capabilities::*CACHED_STRINGS[] = {
+    &term::Capabilities::name, &term::Capabilities::softReset, &term::Capabilities::clearScreen,
+    &term::Capabilities::clearEol, &term::Capabilities::clearBol, &term::Capabilities::clearEos,
+    &term::Capabilities::cursorAddress, &term::Capabilities::columnAddress, &term::Capabilities::cursorRight,
+    &term::Capabilities::cursorLeft, &term::Capabilities::cursorInvisible, &term::Capabilities::cursorNormal,
+    &term::Capabilities::saveCursor, &term::Capabilities::restoreCursor, &term::Capabilities::enterCaMode,
+    &term::Capabilities::exitCaMode, &term::Capabilities::scrollRegion, &term::Capabilities::eraseChars,
+    &term::Capabilities::repeatChar, &term::Capabilities::exitAttributes,
+};
+
+/** @brief Read a little endian 16 bit value, -1 out of bounds */
+inline int readShort(const unsigned char *data, const std::size_t size, const std::size_t pos)
+{
+    if(pos + 2 > size) {
+        return -1;
+    }
+    return static_cast<std::int16_t>(data[pos] | (data[pos + 1] << 8));
+}
+
+/** @brief Read a number of the numbers section */
+inline int readNumber(const unsigned char *data, const std::size_t size, const std::size_t pos, const bool wide)
+{
+    if(!wide) {
+        return readShort(data, size, pos);
+    }
+    if(pos + 4 > size) {
+        return -1;
+    }
+    return static_cast<std::int32_t>(data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16)
+                                     | (std::uint32_t(data[pos + 3]) << 24));
+}
+
+/** @brief Read a NUL terminated string of a string table */
+inline std::string_view readString(const unsigned char *table, const std::size_t size, const int offset)
+{
+    if(offset < 0 || static_cast<std::size_t>(offset) >= size) {
+        return std::string_view();
+    }
+    const char *begin = reinterpret_cast<const char*>(table) + offset;
+    const void *end = std::memchr(begin, '\0', size - static_cast<std::size_t>(offset));
+    if(end == nullptr) {
+        return std::string_view();
+    }
+    return std::string_view(begin, static_cast<std::size_t>(static_cast<const char*>(end) - begin));
+}
+
+/** @brief Copy a capability string without its $<..> padding delays */
+inline std::string stripPadding(std::string_view cap)
+{
+    std::string s;
+    s.reserve(cap.size());
+    for(std::size_t i = 0; i < cap.size(); ++i) {
+        if(cap[i] == '$' && i + 1 < cap.size() && cap[i + 1] == '<') {
+            const std::size_t end = cap.find('>', i);
+            if(end != std::string_view::npos) {
+                i = end;
+                continue;
+            }
+        }
+        s += cap[i];
+    }
+    return s;
+}
+
+/**
+ * @brief Parse a compiled terminfo entry
+ *
+ * Handles the legacy format and the format with 32 bit numbers, with their
+ * extended capabilities. Capabilities missing from the entry are cleared.
+ *
+ * @param data entry content
+ * @param size entry size
+ * @param caps filled with the entry
+ * @return False if the entry is not valid
+ */
+inline bool parseTerminfo(const unsigned char *data, const std::size_t size, term::Capabilities& caps)
+{
+    const int magic = readShort(data, size, 0);
+    if(magic != TERMINFO_MAGIC && magic != TERMINFO_MAGIC32) {
+        return false;
+    }
+    const bool wide = magic == TERMINFO_MAGIC32;
+    const std::size_t numSize = wide ? 4 : 2;
+    const int namesSize = readShort(data, size, 2);
+    const int boolCount = readShort(data, size, 4);
+    const int numCount = readShort(data, size, 6);
+    const int strCount = readShort(data, size, 8);
+    const int tableSize = readShort(data, size, 10);
+    if(namesSize < 0 || boolCount < 0 || numCount < 0 || strCount < 0 || tableSize < 0) {
+        return false;
+    }
+
+    std::size_t pos = 12 + static_cast<std::size_t>(namesSize);
+    const std::size_t bools = pos;
+    pos += static_cast<std::size_t>(boolCount);
+    pos += pos % 2;
+    const std::size_t nums = pos;
+    pos += static_cast<std::size_t>(numCount) * numSize;
+    const std::size_t strs = pos;
+    pos += static_cast<std::size_t>(strCount) * 2;
+    const std::size_t table = pos;
+    pos += static_cast<std::size_t>(tableSize);
+    if(pos > size) {
+        return false;
+    }
+
+    auto flag = [&](const int index) {
+        return index < boolCount && data[bools + static_cast<std::size_t>(index)] == 1;
+    };
+    auto number = [&](const int index) {
+        return index < numCount ? readNumber(data, size, nums + static_cast<std::size_t>(index) * numSize, wide) : -1;
+    };
+
+    caps.autoMargin = flag(TI_AM);
+    caps.backColorErase = flag(TI_BCE);
+    caps.colors = std::max(number(TI_COLORS), 0);
+    caps.trueColor = false;
+    for(const auto& entry : TI_STRINGS) {
+        std::string_view value;
+        if(entry.index < strCount) {
+            const int offset = readShort(data, size, strs + static_cast<std::size_t>(entry.index) * 2);
+            value = readString(data + table, static_cast<std::size_t>(tableSize), offset);
+        }
+        caps.*entry.member = stripPadding(value);
+    }
+    if(caps.softReset.find("\x1b" "c") != std::string::npos) {
+        // RIS clears the screen and scrollback, e.g. rs2 of screen
+        caps.softReset.clear();
+    }
+
+    // Extended capabilities follow on an even offset
+    pos += pos % 2;
+    const int extBools = readShort(data, size, pos);
+    const int extNums = readShort(data, size, pos + 2);
+    const int extStrs = readShort(data, size, pos + 4);
+    const int extTableSize = readShort(data, size, pos + 8);
+    if(extBools < 0 || extNums < 0 || extStrs < 0 || extTableSize < 0) {
+        return true;
+    }
+    pos += 10;
+    const std::size_t extBoolPos = pos;
+    pos += static_cast<std::size_t>(extBools);
+    pos += pos % 2;
+    const std::size_t extNumPos = pos;
+    pos += static_cast<std::size_t>(extNums) * numSize;
+    const std::size_t extStrPos = pos;
+    const std::size_t names = static_cast<std::size_t>(extBools + extNums + extStrs);
+    pos += (static_cast<std::size_t>(extStrs) + names) * 2;
+    const std::size_t extTable = pos;
+    if(pos + static_cast<std::size_t>(extTableSize) > size) {
+        return true;
+    }
+    const unsigned char *ext = data + extTable;
+    const std::size_t extSize = static_cast<std::size_t>(extTableSize);
+
+    // Names are stored after the last string value
+    std::size_t valuesEnd = 0;
+    for(int i = 0; i < extStrs; ++i) {
+        const int offset = readShort(data, size, extStrPos + static_cast<std::size_t>(i) * 2);
+        const std::string_view value = readString(ext, extSize, offset);
+        if(offset >= 0 && value.data() != nullptr) {
+            valuesEnd = std::max(valuesEnd, static_cast<std::size_t>(offset) + value.size() + 1);
+        }
+    }
+    auto name = [&](const std::size_t i) {
+        const int offset = readShort(data, size, extStrPos + (static_cast<std::size_t>(extStrs) + i) * 2);
+        if(offset < 0 || valuesEnd > extSize) {
+            return std::string_view();
+        }
+        return readString(ext + valuesEnd, extSize - valuesEnd, offset);
+    };
+
+    for(int i = 0; i < extBools; ++i) {
+        const std::string_view n = name(static_cast<std::size_t>(i));
+        if((n == "Tc" || n == "RGB") && data[extBoolPos + static_cast<std::size_t>(i)] == 1) {
+            caps.trueColor = true;
+        }
+    }
+    for(int i = 0; i < extNums; ++i) {
+        const std::string_view n = name(static_cast<std::size_t>(extBools + i));
+        if(n == "RGB" && readNumber(data, size, extNumPos + static_cast<std::size_t>(i) * numSize, wide) > 0) {
+            caps.trueColor = true;
+        }
+    }
+    for(int i = 0; i < extStrs; ++i) {
+        const std::string_view n = name(static_cast<std::size_t>(extBools + extNums + i));
+        if(n == "RGB" && readShort(data, size, extStrPos + static_cast<std::size_t>(i) * 2) >= 0) {
+            caps.trueColor = true;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Find the compiled entry of a terminal
+ *
+ * Searches $TERMINFO, ~/.terminfo, $TERMINFO_DIRS and the system
+ * directories, with letter and hexadecimal subdirectories.
+ *
+ * @param name terminal name
+ * @param path set to the entry path
+ * @param st set to the entry status
+ * @return False if not found
+ */
+inline bool findTerminfo(const std::string& name, std::string& path, struct stat& st)
+{
+    if(name.empty() || name.find('/') != std::string::npos) {
+        return false;
+    }
+    auto tryDir = [&](std::string_view dir) {
+        if(dir.empty()) {
+            return false;
+        }
+        static constexpr char HEX[] = "0123456789abcdef";
+        const unsigned char first = static_cast<unsigned char>(name[0]);
+        const std::string subdirs[] = { std::string(1, name[0]), std::string { HEX[first >> 4], HEX[first & 15] } };
+        for(const std::string& sub : subdirs) {
+            path.assign(dir);
+            path += '/';
+            path += sub;
+            path += '/';
+            path += name;
+            if(stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if(const char *env = std::getenv("TERMINFO"); env != nullptr && tryDir(env)) {
+        return true;
+    }
+    if(const char *home = std::getenv("HOME"); home != nullptr && tryDir(std::string(home) + "/.terminfo")) {
+        return true;
+    }
+    static constexpr std::string_view SYSTEM_DIRS[] = { "/etc/terminfo", "/lib/terminfo", "/usr/share/terminfo",
+                                                        "/usr/lib/terminfo" };
+    if(const char *dirs = std::getenv("TERMINFO_DIRS"); dirs != nullptr) {
+        std::string_view list(dirs);
+        while(true) {
+            const std::size_t sep = list.find(':');
+            const std::string_view dir = list.substr(0, sep);
+            if(dir.empty()) {
+                // An empty entry stands for the system directories
+                for(std::string_view sys : SYSTEM_DIRS) {
+                    if(tryDir(sys)) {
+                        return true;
+                    }
+                }
+            } else if(tryDir(dir)) {
+                return true;
+            }
+            if(sep == std::string_view::npos) {
+                break;
+            }
+            list.remove_prefix(sep + 1);
+        }
+    }
+    for(std::string_view sys : SYSTEM_DIRS) {
+        if(tryDir(sys)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @brief Path of the capability cache of a terminal, empty if no cache dir */
+inline std::string capsCachePath(const std::string& name)
+{
+    std::string path;
+    if(const char *cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr && cache[0] != '\0') {
+        path = cache;
+    } else if(const char *home = std::getenv("HOME"); home != nullptr && home[0] != '\0') {
+        path = std::string(home) + "/.cache";
+    } else {
+        return path;
+    }
+    return path + "/term/" + name + ".caps";
+}
+
+/** @brief Cache header identifying the source entry */
+struct CapsCacheHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::int64_t sec;
+    std::int64_t nsec;
+    std::int64_t size;
+};
+
+inline CapsCacheHeader capsCacheHeader(const struct stat& st)
+{
+    return CapsCacheHeader { { 'T', 'C', 'A', 'P' }, CAPS_CACHE_VERSION, static_cast<std::int64_t>(st.st_mtim.tv_sec),
+                             static_cast<std::int64_t>(st.st_mtim.tv_nsec), static_cast<std::int64_t>(st.st_size) };
+}
+
+/**
+ * @brief Load capabilities from the cache if it matches the entry
+ *
+ * @return False if there is no cache or if the entry changed
+ */
+inline bool readCapsCache(const std::string& cachePath, const struct stat& st, term::Capabilities& caps)
+{
+    const int fd = ::open(cachePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return false;
+    }
+    char buf[4096];
+    const ssize_t n = ::read(fd, buf, sizeof(buf));
+    ::close(fd);
+    const CapsCacheHeader expected = capsCacheHeader(st);
+    if(n < static_cast<ssize_t>(sizeof(CapsCacheHeader)) || std::memcmp(buf, &expected, sizeof(expected)) != 0) {
+        return false;
+    }
+
+    const std::size_t size = static_cast<std::size_t>(n);
+    std::size_t pos = sizeof(CapsCacheHeader);
+    term::Capabilities loaded;
+    for(std::string term::Capabilities::*member : CACHED_STRINGS) {
+        std::uint16_t len = 0;
+        if(pos + sizeof(len) > size) {
+            return false;
+        }
+        std::memcpy(&len, buf + pos, sizeof(len));
+        pos += sizeof(len);
+        if(pos + len > size) {
+            return false;
+        }
+        (loaded.*member).assign(buf + pos, len);
+        pos += len;
+    }
+    std::int32_t values[4];
+    if(pos + sizeof(values) > size) {
+        return false;
+    }
+    std::memcpy(values, buf + pos, sizeof(values));
+    loaded.colors = values[0];
+    loaded.trueColor = values[1] != 0;
+    loaded.backColorErase = values[2] != 0;
+    loaded.autoMargin = values[3] != 0;
+    caps = std::move(loaded);
+    return true;
+}
+
+/** @brief Store capabilities in the cache, replacing it atomically */
+inline void writeCapsCache(const std::string& cachePath, const struct stat& st, const term::Capabilities& caps)
+{
+    std::string data;
+    const CapsCacheHeader header = capsCacheHeader(st);
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(std::string term::Capabilities::*member : CACHED_STRINGS) {
+        const std::string& value = caps.*member;
+        const std::uint16_t len = static_cast<std::uint16_t>(std::min<std::size_t>(value.size(), 1024));
+        data.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        data.append(value, 0, len);
+    }
+    const std::int32_t values[4] = { caps.colors, caps.trueColor, caps.backColorErase, caps.autoMargin };
+    data.append(reinterpret_cast<const char*>(values), sizeof(values));
+    if(data.size() > 4096) {
+        return;
+    }
+
+    // Create the cache directories, ignoring errors
+    for(std::size_t sep = cachePath.find('/', 1); sep != std::string::npos; sep = cachePath.find('/', sep + 1)) {
+        mkdir(cachePath.substr(0, sep).c_str(), 0700);
+    }
+    const std::string tmp = cachePath + "." + std::to_string(getpid());
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd < 0) {
+        return;
+    }
+    const bool written = ::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+    ::close(fd);
+    if(!written || rename(tmp.c_str(), cachePath.c_str()) != 0) {
+        unlink(tmp.c_str());
+    }
+}
+
+#endif
+
+};
+
+namespace term
+{
+
+  /**
+   * @brief Load the capabilities of a terminal from the terminfo database
+   *
+   * The entry is memory mapped and parsed, unless the capability cache holds
+   * a copy made from the same entry file, keyed by name and modification
+   * time.
+   *
+   * @param caps filled with the capabilities
+   * @param name terminal name. Default is $TERM
+   * @param useCache true to read and update the cache. Default is true
+   * @return False if no valid entry was found, caps is then unchanged
+   */
+  inline bool loadTerminfo(Capabilities& caps, std::string name = std::string(), const bool useCache = true)
+  {
+#ifdef __linux__
+    if (name.empty())
+    {
+      const char *env = std::getenv("TERM");
+      if (env == nullptr)
+      {
+	return false;
+      }
+      name = env;
+    }
+
+    std::string path;
+    struct stat st;
+    if (!termUtils::findTerminfo(name, path, st))
+    {
+      return false;
+    }
+    const std::string cachePath = useCache ? termUtils::capsCachePath(name) : std::string();
+    if (!cachePath.empty() && termUtils::readCapsCache(cachePath, st, caps))
+    {
+      return true;
+    }
+
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || st.st_size <= 0)
+    {
+      if (fd >= 0)
+      {
+	::close(fd);
+      }
+      return false;
+    }
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+      return false;
+    }
+
+    Capabilities parsed;
+    parsed.name = name;
+    const bool valid = termUtils::parseTerminfo(static_cast<const unsigned char*>(data), size, parsed);
+    munmap(data, size);
+    if (!valid)
+    {
+      return false;
+    }
+    caps = std::move(parsed);
+    if (!cachePath.empty())
+    {
+      termUtils::writeCapsCache(cachePath, st, caps);
+    }
+    return true;
+#else
+    (void) caps;
+    (void) name;
+    (void) useCache;
+    return false;
+#endif
+  }
+
+  /**
+   * @brief Load the capabilities of $TERM and use them in the library
+   *
+   * @return False if no entry was found, the xterm defaults are then kept
+   */
+  inline bool initCapabilities()
+  {
+    Capabilities caps;
+    if (!loadTerminfo(caps))
+    {
+      return false;
+    }
+    setCapabilities(caps);
+    return true;
+  }
+
+}
+
+#endif // TERMINFO_HPP
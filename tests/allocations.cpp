@@ -0,0 +1,187 @@
+/*
+ * Checks that the escape helpers, key decoding and steady-state frames do
+ * not call the global allocator, see arena.hpp.
+ */
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <memory_resource>
+#include <new>
+#include <ostream>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "output.hpp"
+#include "table.hpp"
+#include "term.hpp"
+
+namespace
+{
+
+  std::size_t allocations = 0;
+
+  /** @brief Output counting the bytes written, without storing them */
+  class NullBuffer : public std::streambuf
+  {
+    public:
+      std::size_t bytes = 0;
+
+    protected:
+      int overflow(const int c) override
+      {
+	++bytes;
+	return c;
+      }
+
+      std::streamsize xsputn(const char*, const std::streamsize n) override
+      {
+	bytes += static_cast<std::size_t>(n);
+	return n;
+      }
+  };
+
+  /**
+   * @brief Count the allocations of a step once warmed up
+   *
+   * The first runs size the buffers; an arena grows at the start of the
+   * frame after its peak.
+   *
+   * @return True if the last run did not allocate
+   */
+  template<typename F>
+  bool check(const char *name, F step)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      step();
+    }
+    const std::size_t before = allocations;
+    step();
+    const std::size_t count = allocations - before;
+    std::printf("%-24s %zu allocations\n", name, count);
+    return count == 0;
+  }
+
+}
+
+void *operator new(const std::size_t size)
+{
+  ++allocations;
+  if (void *p = std::malloc(size > 0 ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new(const std::size_t size, const std::align_val_t alignment)
+{
+  ++allocations;
+  const std::size_t align = static_cast<std::size_t>(alignment);
+  if (void *p = std::aligned_alloc(align, (size + align - 1) / align * align))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+int main()
+{
+  NullBuffer buffer;
+  std::ostream os(&buffer);
+  bool ok = true;
+
+  ok &= check("escape helpers", [&os]
+  {
+    term::color::fg(200, os, false);
+    term::color::bgRgb(10, 20, 30, os, false);
+    term::cursor::move(12, 40, os, false);
+    term::cursor::moveUp(3, os, false);
+    term::cursor::moveToCol(7, os, false);
+    termUtils::writeCsi(os, "38;2;", { 1, 2, 3 }, 'm');
+    os << term::color::FG<196>;
+  });
+
+  ok &= check("decodeKey", []
+  {
+    static const int keys[][6] = {
+      { 'a' }, { 0xC3, 0xA9 }, { 27, 'x' }, { 27, '[', 'A' }, { 27, '[', '1', ';', '5', 'A' }, { 27, 'O', 'P' } };
+    static const std::size_t lengths[] = { 1, 2, 2, 3, 6, 3 };
+    for (std::size_t i = 0; i < std::size(keys); ++i)
+    {
+      term::decodeKey(std::span<const int>(keys[i], lengths[i]));
+    }
+  });
+
+  // Frames written to /dev/null, so that every write completes
+  const int fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    std::perror("/dev/null");
+    return 1;
+  }
+  {
+    term::Output output(fd);
+    term::CellBuffer frames[2] = { term::CellBuffer(term::Size(50, 160)), term::CellBuffer(term::Size(50, 160)) };
+    for (std::size_t r = 0; r < 50; r += 3)
+    {
+      frames[1].print(r, r, "changed row", term::Style { term::color::rgb(255, 128, 0), 0, 0 });
+    }
+    std::size_t frame = 0;
+    ok &= check("Output frame", [&]
+    {
+      output.submit(frames[frame++ % 2]);
+      output.submit(frames[frame++ % 2]);
+    });
+  }
+  ::close(fd);
+
+  term::Table table({ "id", "name", "size" }, [&table](const std::size_t row, std::vector<std::string_view>& cells)
+  {
+    if (row >= 100000)
+    {
+      return false;
+    }
+    std::pmr::string *id = new (table.arena().allocate(sizeof(std::pmr::string), alignof(std::pmr::string)))
+	std::pmr::string(&table.arena());
+    id->resize(20);
+    id->resize(static_cast<std::size_t>(std::to_chars(id->data(), id->data() + id->size(), row).ptr - id->data()));
+    cells.assign({ *id, "entry", "1024" });
+    return true;
+  }, 100000);
+  std::size_t top = 0;
+  ok &= check("Table frame", [&]
+  {
+    table.render(term::Rect { top++, 0, 30, 80 }, os, false);
+  });
+
+  return ok ? 0 : 1;
+}
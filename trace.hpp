@@ -0,0 +1,477 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace term
+{
+
+  /** @brief Steps between a key press and the bytes of its frame */
+  enum class TraceStage : unsigned char
+  {
+    Input,
+    Dispatch,
+    Build,
+    Diff,
+    Write
+  };
+
+  /** @brief Durations in power of two buckets of microseconds */
+  struct Histogram
+  {
+      /** @brief Bucket i counts durations below 2^i us, the last one the longer ones */
+      std::array<std::uint64_t, 24> buckets {};
+      std::uint64_t count = 0;
+      std::uint64_t total = 0;
+      std::uint64_t max = 0;
+
+      void add(const std::uint64_t us)
+      {
+	std::size_t i = 0;
+	while (i + 1 < buckets.size() && us >= (std::uint64_t(1) << i))
+	{
+	  ++i;
+	}
+	++buckets[i];
+	++count;
+	total += us;
+	max = std::max(max, us);
+      }
+
+      /**
+       * @brief Upper bound of a percentile
+       *
+       * @param p percentile from 0 to 100
+       * @return Duration in us, the bucket bound or max
+       */
+      std::uint64_t percentile(const double p) const
+      {
+	const double rank = static_cast<double>(count) * p / 100;
+	std::uint64_t seen = 0;
+	for (std::size_t i = 0; i < buckets.size(); ++i)
+	{
+	  seen += buckets[i];
+	  if (seen > 0 && static_cast<double>(seen) >= rank)
+	  {
+	    return std::min(max, std::uint64_t(1) << i);
+	  }
+	}
+	return max;
+      }
+  };
+
+  /**
+   * @brief Latency tracing of the way from input to output
+   *
+   * Each key read gets an id; the steps run afterwards, handling, frame
+   * building, diff and write, are recorded with the id of the last key read,
+   * so the write ending a step gives the latency of every key before it.
+   *
+   * Events go to a ring of fixed size written without lock by any thread,
+   * the oldest ones being overwritten. Reading it, to export a Chrome trace
+   * or histograms, is safe while threads record.
+   *
+   * The library records events only when TERM_ENABLE_TRACE is defined, see
+   * the TERM_TRACE macros.
+   */
+  class Tracer
+  {
+    public:
+      using Clock = std::chrono::steady_clock;
+
+      /** @brief One recorded step, times in ns since the tracer start */
+      struct Event
+      {
+	  std::uint64_t time;
+	  std::uint64_t id;
+	  unsigned thread;
+	  TraceStage stage;
+	  /** @brief 'B' begin, 'E' end or 'I' instant, as in Chrome traces */
+	  char phase;
+      };
+
+      /**
+       * @brief Create a tracer
+       *
+       * @param capacity number of events kept, rounded up to a power of two
+       */
+      explicit Tracer(const std::size_t capacity = 64 * 1024)
+      {
+	std::size_t size = 1;
+	while (size < capacity)
+	{
+	  size *= 2;
+	}
+	slots = std::make_unique<Slot[]>(size);
+	mask = size - 1;
+      }
+
+      Tracer(const Tracer&) = delete;
+      Tracer& operator=(const Tracer&) = delete;
+
+      /** @brief Start or stop recording, on by default */
+      void setEnabled(const bool enabled)
+      {
+	on.store(enabled, std::memory_order_relaxed);
+      }
+
+      bool enabled() const
+      {
+	return on.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Record a key read
+       *
+       * @return Id of the key, 0 when not recording
+       */
+      std::uint64_t input()
+      {
+	if (!enabled())
+	{
+	  return 0;
+	}
+	const std::uint64_t id = lastId.fetch_add(1, std::memory_order_relaxed) + 1;
+	record(TraceStage::Input, 'I', id);
+	return id;
+      }
+
+      /**
+       * @brief Record the start of a step
+       *
+       * @return Id of the last key read, to pass to end()
+       */
+      std::uint64_t begin(const TraceStage stage)
+      {
+	if (!enabled())
+	{
+	  return 0;
+	}
+	const std::uint64_t id = lastId.load(std::memory_order_relaxed);
+	record(stage, 'B', id);
+	return id;
+      }
+
+      /**
+       * @brief Record the end of a step
+       *
+       * @param id value returned by begin(): keys read during the step are
+       * not handled by it
+       */
+      void end(const TraceStage stage, const std::uint64_t id)
+      {
+	if (enabled())
+	{
+	  record(stage, 'E', id);
+	}
+      }
+
+      /** @brief Forget the recorded events, not while threads record */
+      void clear()
+      {
+	for (std::size_t i = 0; i <= mask; ++i)
+	{
+	  slots[i].sequence.store(0, std::memory_order_relaxed);
+	}
+	head.store(0, std::memory_order_relaxed);
+      }
+
+      /** @brief Number of events overwritten by newer ones */
+      std::uint64_t dropped() const
+      {
+	const std::uint64_t n = head.load(std::memory_order_acquire);
+	return n > mask + 1 ? n - mask - 1 : 0;
+      }
+
+      /** @brief Events in the ring, oldest first */
+      std::vector<Event> events() const
+      {
+	std::vector<Event> list;
+	const std::uint64_t last = head.load(std::memory_order_acquire);
+	const std::uint64_t first = last > mask + 1 ? last - mask - 1 : 0;
+	list.reserve(static_cast<std::size_t>(last - first));
+	for (std::uint64_t n = first; n < last; ++n)
+	{
+	  const Slot& slot = slots[n & mask];
+	  const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+	  if (sequence != 2 * n + 2)
+	  {
+	    // Being written, or already overwritten
+	    continue;
+	  }
+	  const std::uint64_t time = slot.time.load(std::memory_order_relaxed);
+	  const std::uint64_t info = slot.info.load(std::memory_order_relaxed);
+	  std::atomic_thread_fence(std::memory_order_acquire);
+	  if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+	  {
+	    continue;
+	  }
+	  list.push_back(Event { time, info >> 24, static_cast<unsigned>((info >> 8) & 0xFFFF),
+				 static_cast<TraceStage>((info >> 4) & 0xF), PHASES[info & 0xF] });
+	}
+	// Events of different threads may be stored out of order
+	std::stable_sort(list.begin(), list.end(), [](const Event& a, const Event& b)
+	{
+	  return a.time < b.time;
+	});
+	return list;
+      }
+
+      /**
+       * @brief Write the events as Chrome trace JSON, for chrome://tracing
+       * or Perfetto
+       *
+       * Steps are slices per thread, keys instant events carrying their id,
+       * and each key is linked by a flow arrow to the write ending it.
+       */
+      void writeChromeTrace(std::ostream& os) const
+      {
+	const std::vector<Event> list = events();
+	os << "{\"traceEvents\":[";
+	bool first = true;
+	auto event = [&os, &first](const Event& e, const char phase, const std::string_view label)
+	{
+	  os << (first ? "\n" : ",\n");
+	  first = false;
+	  os << "{\"name\":\"" << label << "\",\"cat\":\"term\",\"ph\":\"" << phase << "\",\"ts\":"
+	     << e.time / 1000 << '.' << char('0' + e.time / 100 % 10) << ",\"pid\":1,\"tid\":" << e.thread;
+	};
+	// Keys waiting for a write
+	std::vector<std::uint64_t> keys;
+	for (const Event& e : list)
+	{
+	  event(e, e.phase == 'I' ? 'i' : e.phase, name(e.stage));
+	  if (e.phase == 'I')
+	  {
+	    os << ",\"s\":\"t\",\"args\":{\"id\":" << e.id << "}}";
+	    // Both ends of a flow need the same name
+	    event(e, 's', "latency");
+	    os << ",\"id\":" << e.id << '}';
+	    keys.push_back(e.id);
+	    continue;
+	  }
+	  os << ",\"args\":{\"id\":" << e.id << "}}";
+	  if (e.stage == TraceStage::Write && e.phase == 'E')
+	  {
+	    // The first write after a key ends its flow
+	    std::size_t kept = 0;
+	    for (const std::uint64_t id : keys)
+	    {
+	      if (id <= e.id)
+	      {
+		event(e, 'f', "latency");
+		os << ",\"bp\":\"e\",\"id\":" << id << '}';
+	      }
+	      else
+	      {
+		keys[kept++] = id;
+	      }
+	    }
+	    keys.resize(kept);
+	  }
+	}
+	os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+      }
+
+      /** @brief Durations of a step, from its begin and end events */
+      Histogram durations(const TraceStage stage) const
+      {
+	Histogram histogram;
+	// Open steps per thread, nested steps of the same stage are matched inner first
+	std::vector<std::pair<unsigned, std::uint64_t>> open;
+	for (const Event& e : events())
+	{
+	  if (e.stage != stage)
+	  {
+	    continue;
+	  }
+	  if (e.phase == 'B')
+	  {
+	    open.emplace_back(e.thread, e.time);
+	  }
+	  else if (e.phase == 'E')
+	  {
+	    const auto it = std::find_if(open.rbegin(), open.rend(), [&e](const auto& o)
+	    {
+	      return o.first == e.thread;
+	    });
+	    if (it != open.rend())
+	    {
+	      histogram.add((e.time - it->second) / 1000);
+	      open.erase(std::next(it).base());
+	    }
+	  }
+	}
+	return histogram;
+      }
+
+      /** @brief Time from each key read to the end of the next write */
+      Histogram latency() const
+      {
+	Histogram histogram;
+	std::vector<Event> keys;
+	for (const Event& e : events())
+	{
+	  if (e.phase == 'I')
+	  {
+	    keys.push_back(e);
+	  }
+	  else if (e.stage == TraceStage::Write && e.phase == 'E')
+	  {
+	    std::size_t kept = 0;
+	    for (const Event& key : keys)
+	    {
+	      if (key.id <= e.id)
+	      {
+		histogram.add((e.time - key.time) / 1000);
+	      }
+	      else
+	      {
+		keys[kept++] = key;
+	      }
+	    }
+	    keys.resize(kept);
+	  }
+	}
+	return histogram;
+      }
+
+      /** @brief Write a table of the step durations and the key latency */
+      void writeSummary(std::ostream& os) const
+      {
+	auto line = [&os](const std::string_view label, const Histogram& h)
+	{
+	  os << label;
+	  for (std::size_t i = label.size(); i < 10; ++i)
+	  {
+	    os << ' ';
+	  }
+	  os << "count " << h.count;
+	  if (h.count > 0)
+	  {
+	    os << "  mean " << h.total / h.count << " us  p50 <" << h.percentile(50) << " us  p99 <"
+	       << h.percentile(99) << " us  max " << h.max << " us";
+	  }
+	  os << '\n';
+	};
+	for (const TraceStage stage : { TraceStage::Dispatch, TraceStage::Build, TraceStage::Diff, TraceStage::Write })
+	{
+	  line(name(stage), durations(stage));
+	}
+	line("latency", latency());
+	if (dropped() > 0)
+	{
+	  os << dropped() << " events overwritten\n";
+	}
+      }
+
+      static std::string_view name(const TraceStage stage)
+      {
+	static constexpr std::string_view NAMES[] = { "input", "dispatch", "build", "diff", "write" };
+	return NAMES[static_cast<std::size_t>(stage)];
+      }
+
+    private:
+      static constexpr char PHASES[] = { 'B', 'E', 'I' };
+
+      /** @brief Event stored as atomic words, sequence is 2 n + 2 once event n is written */
+      struct Slot
+      {
+	  std::atomic<std::uint64_t> sequence { 0 };
+	  std::atomic<std::uint64_t> time { 0 };
+	  std::atomic<std::uint64_t> info { 0 };
+      };
+
+      std::unique_ptr<Slot[]> slots;
+      std::size_t mask = 0;
+      std::atomic<std::uint64_t> head { 0 };
+      std::atomic<std::uint64_t> lastId { 0 };
+      std::atomic<bool> on { true };
+      std::atomic<unsigned> threads { 0 };
+      const Clock::time_point start = Clock::now();
+
+      void record(const TraceStage stage, const char phase, const std::uint64_t id)
+      {
+	thread_local unsigned thread = 0;
+	if (thread == 0)
+	{
+	  thread = threads.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+	const std::uint64_t time = static_cast<std::uint64_t>(
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+	const std::uint64_t info = id << 24 | std::uint64_t(thread & 0xFFFF) << 8
+				   | std::uint64_t(static_cast<unsigned>(stage)) << 4
+				   | std::uint64_t(phase == 'B' ? 0 : phase == 'E' ? 1 : 2);
+
+	const std::uint64_t n = head.fetch_add(1, std::memory_order_relaxed);
+	Slot& slot = slots[n & mask];
+	// Odd while written, readers skip the slot
+	slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.time.store(time, std::memory_order_relaxed);
+	slot.info.store(info, std::memory_order_relaxed);
+	slot.sequence.store(2 * n + 2, std::memory_order_release);
+      }
+  };
+
+  /** @brief Tracer of the process, used by the TERM_TRACE macros */
+  inline Tracer& tracer()
+  {
+    static Tracer instance;
+    return instance;
+  }
+
+  /** @brief Record a step for the lifetime of the object */
+  class TraceScope
+  {
+    public:
+      explicit TraceScope(const TraceStage stage)
+	  : stage(stage), id(tracer().begin(stage))
+      {
+      }
+
+      ~TraceScope()
+      {
+	tracer().end(stage, id);
+      }
+
+      /** @brief The step did not complete the output of the keys, e.g. a partial write */
+      void unfinished()
+      {
+	id = 0;
+      }
+
+      TraceScope(const TraceScope&) = delete;
+      TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+      TraceStage stage;
+      std::uint64_t id;
+  };
+
+}
+
+/*
+ * Hooks of the library, compiled only with TERM_ENABLE_TRACE. Applications
+ * can use them too, e.g. around their key handlers:
+ *   TERM_TRACE_SCOPE(Dispatch);
+ */
+#ifdef TERM_ENABLE_TRACE
+#define TERM_TRACE_CONCAT(a, b) a##b
+#define TERM_TRACE_NAME(line) TERM_TRACE_CONCAT(termTraceScope, line)
+#define TERM_TRACE_INPUT() term::tracer().input()
+#define TERM_TRACE_SCOPE(stage) const term::TraceScope TERM_TRACE_NAME(__LINE__)(term::TraceStage::stage)
+#else
+#define TERM_TRACE_INPUT() ((void)0)
+#define TERM_TRACE_SCOPE(stage) ((void)0)
+#endif
+
+#endif // TRACE_HPP
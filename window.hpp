@@ -0,0 +1,437 @@
+#ifndef WINDOW_HPP
+#define WINDOW_HPP
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cell.hpp"
+#include "rowCache.hpp"
+#include "trace.hpp"
+
+namespace term
+{
+
+  class Compositor;
+
+  /**
+   * @brief Off-screen surface placed on the screen by a Compositor
+   *
+   * Drawing and geometry changes record damage in the compositor so that only
+   * the affected screen area is redrawn. Coordinates of drawing functions are
+   * relative to the window, which is clipped to the screen.
+   */
+  class Window
+  {
+    public:
+      Window(Compositor& compositor, const Rect& rect, const int z)
+	  : compositor(compositor), surface(Size(rect.rows, rect.cols)), position(rect), depth(z)
+      {
+      }
+
+      Window(const Window&) = delete;
+      Window& operator=(const Window&) = delete;
+
+      /** @brief Position and size on the screen */
+      const Rect& rect() const
+      {
+	return position;
+      }
+
+      /** @brief Stacking order, higher is drawn on top */
+      int z() const
+      {
+	return depth;
+      }
+
+      bool visible() const
+      {
+	return shown;
+      }
+
+      /** @brief Cells of the window. Call damage() after direct changes */
+      CellBuffer& buffer()
+      {
+	return surface;
+      }
+
+      const CellBuffer& buffer() const
+      {
+	return surface;
+      }
+
+      /** @brief Set a cell */
+      void put(const std::size_t row, const std::size_t col, const Cell& cell)
+      {
+	if (row < position.rows && col < position.cols)
+	{
+	  surface.at(row, col) = cell;
+	  damage(Rect { row, col, 1, 1 });
+	}
+      }
+
+      /**
+       * @brief Write UTF-8 text, clipped to the window
+       *
+       * @return Column after the last written cell
+       */
+      std::size_t print(const std::size_t row, const std::size_t col, std::string_view text, const Style& style =
+			    Style())
+      {
+	const std::size_t end = surface.print(row, col, text, style);
+	if (end > col)
+	{
+	  damage(Rect { row, col, 1, end - col });
+	}
+	return end;
+      }
+
+      /** @brief Fill the window */
+      void fill(const Cell& cell = Cell())
+      {
+	surface.fill(cell);
+	damage(Rect { 0, 0, position.rows, position.cols });
+      }
+
+      /** @brief Fill a rectangle of the window */
+      void fill(const Rect& rect, const Cell& cell)
+      {
+	surface.fill(rect, cell);
+	damage(rect);
+      }
+
+      /** @brief Mark a rectangle of the window as changed */
+      void damage(const Rect& rect);
+
+      /** @brief Move the window on the screen */
+      void move(const std::size_t row, const std::size_t col);
+
+      /** @brief Change the stacking order */
+      void setZ(const int z);
+
+      void show();
+
+      void hide();
+
+    private:
+      Compositor& compositor;
+      CellBuffer surface;
+      Rect position;
+      int depth;
+      bool shown = true;
+  };
+
+  /**
+   * @brief Stack of windows drawn with damage tracking
+   *
+   * compose() recomputes and compares only the damaged screen areas, so
+   * opening, moving or closing a window costs the area it covers. Areas not
+   * covered by any window show the background cell. Not thread safe.
+   */
+  class Compositor
+  {
+    public:
+      explicit Compositor(const Size& size = term::size(), const Cell& background = Cell())
+	  : current(size), next(size), background(background)
+      {
+      }
+
+      Compositor(const Compositor&) = delete;
+      Compositor& operator=(const Compositor&) = delete;
+
+      const Size& size() const
+      {
+	return next.size();
+      }
+
+      /**
+       * @brief Create a visible window
+       *
+       * @param rect position and size on the screen
+       * @param z stacking order, higher is drawn on top
+       * @return The window, valid until destroy() or the end of the compositor
+       */
+      Window& window(const Rect& rect, const int z = 0)
+      {
+	windows.emplace_back(std::make_unique<Window>(*this, rect, z));
+	Window& win = *windows.back();
+	sort();
+	damage(rect);
+	return win;
+      }
+
+      /**
+       * @brief Remove a window and redraw what was underneath
+       *
+       * Does nothing if the window is not one of this compositor, e.g.
+       * already destroyed.
+       */
+      void destroy(Window& win)
+      {
+	const auto it = std::find_if(windows.begin(), windows.end(), [&win](const std::unique_ptr<Window>& w)
+	{
+	  return w.get() == &win;
+	});
+	if (it == windows.end())
+	{
+	  return;
+	}
+	if ((*it)->visible())
+	{
+	  damage((*it)->rect());
+	}
+	windows.erase(it);
+      }
+
+      /** @brief Resize the screen and redraw everything */
+      void resize(const Size& size)
+      {
+	current.resize(size);
+	next.resize(size);
+	invalidate();
+      }
+
+      /**
+       * @brief Draw mostly changed rows from a cache of rendered rows
+       *
+       * @param rowCache cache outliving this object, nullptr to disable
+       */
+      void setRowCache(RowCache *rowCache)
+      {
+	cache = rowCache;
+      }
+
+      /** @brief Redraw the whole screen on next compose() */
+      void invalidate()
+      {
+	redraw = true;
+      }
+
+      /** @brief Mark a screen rectangle as changed */
+      void damage(const Rect& rect)
+      {
+	const Rect rc = rect.intersect(Rect { 0, 0, size().rows, size().cols });
+	if (rc.empty())
+	{
+	  return;
+	}
+	for (const Rect& old : damaged)
+	{
+	  if (old.intersect(rc) == rc)
+	  {
+	    return;
+	  }
+	}
+	if (damaged.size() < MAX_RECTS)
+	{
+	  damaged.push_back(rc);
+	  return;
+	}
+	// Bounded here so that coalesce() stays cheap however many cells change
+	Rect box = rc;
+	for (const Rect& old : damaged)
+	{
+	  box = bounds(box, old);
+	}
+	damaged.assign(1, box);
+      }
+
+      /**
+       * @brief Draw the damaged areas
+       *
+       * @param os output. Default is std::cout
+       * @param flush true if flushes the output immediately. Default is true
+       * @return True if something was written
+       */
+      bool compose(std::ostream& os = std::cout, const bool flush = true)
+      {
+	TERM_TRACE_SCOPE(Build);
+	out.clear();
+	termUtils::Emitter emitter(out);
+	if (redraw)
+	{
+	  damaged.assign(1, Rect { 0, 0, size().rows, size().cols });
+	  out += color::RESET;
+	  out += clear::ALL_SCREEN;
+	  current.fill();
+	  emitter.invalidate();
+	  redraw = false;
+	}
+	coalesce();
+
+	for (const Rect& rc : damaged)
+	{
+	  next.fill(rc, background);
+	  for (const std::unique_ptr<Window>& win : windows)
+	  {
+	    if (!win->visible())
+	    {
+	      continue;
+	    }
+	    const Rect& pos = win->rect();
+	    const Rect part = rc.intersect(pos);
+	    if (!part.empty())
+	    {
+	      next.blit(win->buffer(), Rect { part.row - pos.row, part.col - pos.col, part.rows, part.cols }, part.row,
+			part.col);
+	    }
+	  }
+	  {
+	    TERM_TRACE_SCOPE(Diff);
+	    if (cache != nullptr)
+	    {
+	      cache->diff(emitter, current, next, rc);
+	    }
+	    else
+	    {
+	      emitter.diff(current, next, rc);
+	    }
+	  }
+	  current.blit(next, rc, rc.row, rc.col);
+	}
+	damaged.clear();
+
+	if (out.empty())
+	{
+	  return false;
+	}
+	emitter.reset();
+	TERM_TRACE_SCOPE(Write);
+	os.write(out.data(), static_cast<std::streamsize>(out.size()));
+	if (flush)
+	{
+	  os << std::flush;
+	}
+	return true;
+      }
+
+    private:
+      friend class Window;
+
+      /** @brief Number of rectangles kept before new damage merges them into one */
+      static constexpr std::size_t MAX_RECTS = 32;
+
+      std::vector<std::unique_ptr<Window>> windows;
+      // Cells on the terminal
+      CellBuffer current;
+      // Cells to display
+      CellBuffer next;
+      Cell background;
+      std::vector<Rect> damaged;
+      std::string out;
+      RowCache *cache = nullptr;
+      bool redraw = true;
+
+      void sort()
+      {
+	std::stable_sort(windows.begin(), windows.end(),
+			 [](const std::unique_ptr<Window>& a, const std::unique_ptr<Window>& b)
+			 {
+			   return a->z() < b->z();
+			 });
+      }
+
+      static Rect bounds(const Rect& a, const Rect& b)
+      {
+	const std::size_t top = std::min(a.row, b.row);
+	const std::size_t left = std::min(a.col, b.col);
+	const std::size_t bottom = std::max(a.row + a.rows, b.row + b.rows);
+	const std::size_t right = std::max(a.col + a.cols, b.col + b.cols);
+	return Rect { top, left, bottom - top, right - left };
+      }
+
+      static std::size_t area(const Rect& rc)
+      {
+	return rc.rows * rc.cols;
+      }
+
+      /**
+       * @brief Merge overlapping rectangles when their bounding box is not
+       * larger than the rectangles themselves, so no cell is compared twice
+       */
+      void coalesce()
+      {
+	bool merged = true;
+	while (merged)
+	{
+	  merged = false;
+	  for (std::size_t i = 0; i < damaged.size() && !merged; ++i)
+	  {
+	    for (std::size_t j = i + 1; j < damaged.size(); ++j)
+	    {
+	      const Rect box = bounds(damaged[i], damaged[j]);
+	      if (!damaged[i].intersect(damaged[j]).empty()
+		  && area(box) <= area(damaged[i]) + area(damaged[j]))
+	      {
+		damaged[i] = box;
+		damaged.erase(damaged.begin() + static_cast<std::ptrdiff_t>(j));
+		merged = true;
+		break;
+	      }
+	    }
+	  }
+	}
+      }
+  };
+
+  inline void Window::damage(const Rect& rect)
+  {
+    if (!shown)
+    {
+      return;
+    }
+    const Rect rc = rect.intersect(Rect { 0, 0, position.rows, position.cols });
+    if (!rc.empty())
+    {
+      compositor.damage(Rect { position.row + rc.row, position.col + rc.col, rc.rows, rc.cols });
+    }
+  }
+
+  inline void Window::move(const std::size_t row, const std::size_t col)
+  {
+    if (shown)
+    {
+      compositor.damage(position);
+    }
+    position.row = row;
+    position.col = col;
+    if (shown)
+    {
+      compositor.damage(position);
+    }
+  }
+
+  inline void Window::setZ(const int z)
+  {
+    depth = z;
+    compositor.sort();
+    if (shown)
+    {
+      compositor.damage(position);
+    }
+  }
+
+  inline void Window::show()
+  {
+    if (!shown)
+    {
+      shown = true;
+      compositor.damage(position);
+    }
+  }
+
+  inline void Window::hide()
+  {
+    if (shown)
+    {
+      compositor.damage(position);
+      shown = false;
+    }
+  }
+
+}
+
+#endif // WINDOW_HPP
@@ -0,0 +1,223 @@
+#ifndef WORKPOOL_HPP
+#define WORKPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace term
+{
+
+  /**
+   * @brief Fixed set of threads running data parallel loops
+   *
+   * run() splits a range into chunks dealt evenly to the workers. A worker
+   * done with its own chunks steals half of the chunks left to another one,
+   * so uneven chunks do not leave threads idle. The remaining chunks of each
+   * worker are a single atomic word, taking and stealing are lock free.
+   */
+  class WorkPool
+  {
+    public:
+      /**
+       * @brief Function processing items [begin, end), called by worker
+       * number worker. It must not throw
+       */
+      using Function = std::function<void(unsigned worker, std::size_t begin, std::size_t end)>;
+
+      /**
+       * @brief Start the threads
+       *
+       * @param workers number of workers including the thread calling run(),
+       * 0 for the number of hardware threads
+       */
+      explicit WorkPool(unsigned workers = 0)
+      {
+	if (workers == 0)
+	{
+	  workers = std::max(1u, std::thread::hardware_concurrency());
+	}
+	slots = std::make_unique<Slot[]>(workers);
+	count = workers;
+	for (unsigned id = 1; id < workers; ++id)
+	{
+	  threads.emplace_back(&WorkPool::work, this, id);
+	}
+      }
+
+      WorkPool(const WorkPool&) = delete;
+      WorkPool& operator=(const WorkPool&) = delete;
+
+      ~WorkPool()
+      {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+	{
+	  thread.join();
+	}
+      }
+
+      /** @brief Number of workers, the calling thread is worker 0 */
+      unsigned size() const
+      {
+	return count;
+      }
+
+      /**
+       * @brief Process items [0, items) in parallel and wait for them
+       *
+       * Not reentrant: call it from one thread at a time, and not from fn.
+       *
+       * @param items number of items
+       * @param grain items per chunk
+       * @param fn function called once per chunk
+       */
+      void run(const std::size_t items, std::size_t grain, const Function& fn)
+      {
+	if (items == 0)
+	{
+	  return;
+	}
+	grain = std::max<std::size_t>(grain, (items + MAX_CHUNKS - 1) / MAX_CHUNKS);
+	const std::size_t chunks = (items + grain - 1) / grain;
+	if (chunks == 1 || count == 1)
+	{
+	  fn(0, 0, items);
+	  return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	job = &fn;
+	jobItems = items;
+	jobGrain = grain;
+	for (unsigned id = 0; id < count; ++id)
+	{
+	  const std::uint64_t begin = chunks * id / count;
+	  const std::uint64_t end = chunks * (id + 1) / count;
+	  slots[id].range.store(begin << 32 | end, std::memory_order_relaxed);
+	}
+	active = count - 1;
+	++round;
+	lock.unlock();
+	wake.notify_all();
+
+	participate(0);
+
+	lock.lock();
+	done.wait(lock, [this] { return active == 0; });
+	job = nullptr;
+      }
+
+    private:
+      // Chunk indices are packed by two in a 64 bit word
+      static constexpr std::size_t MAX_CHUNKS = 0xFFFFFFFF;
+
+      /** @brief Chunks [begin, end) left to a worker, begin << 32 | end */
+      struct alignas(64) Slot
+      {
+	  std::atomic<std::uint64_t> range { 0 };
+      };
+
+      std::unique_ptr<Slot[]> slots;
+      unsigned count = 1;
+      std::vector<std::thread> threads;
+      std::mutex mutex;
+      std::condition_variable wake;
+      std::condition_variable done;
+      const Function *job = nullptr;
+      std::size_t jobItems = 0;
+      std::size_t jobGrain = 0;
+      std::uint64_t round = 0;
+      unsigned active = 0;
+      bool stopping = false;
+
+      void work(const unsigned id)
+      {
+	std::uint64_t seen = 0;
+	while (true)
+	{
+	  {
+	    std::unique_lock<std::mutex> lock(mutex);
+	    wake.wait(lock, [this, seen] { return stopping || round != seen; });
+	    if (stopping)
+	    {
+	      return;
+	    }
+	    seen = round;
+	  }
+	  participate(id);
+	  {
+	    std::lock_guard<std::mutex> lock(mutex);
+	    if (--active == 0)
+	    {
+	      done.notify_one();
+	    }
+	  }
+	}
+      }
+
+      /** @brief Run own chunks, then stolen ones, until none is left */
+      void participate(const unsigned id)
+      {
+	std::size_t chunk;
+	while (take(id, chunk) || (steal(id) && take(id, chunk)))
+	{
+	  const std::size_t begin = chunk * jobGrain;
+	  (*job)(id, begin, std::min(begin + jobGrain, jobItems));
+	}
+      }
+
+      /** @brief Take the first chunk left to a worker */
+      bool take(const unsigned id, std::size_t& chunk)
+      {
+	std::atomic<std::uint64_t>& range = slots[id].range;
+	std::uint64_t value = range.load(std::memory_order_acquire);
+	while ((value >> 32) < (value & 0xFFFFFFFF))
+	{
+	  if (range.compare_exchange_weak(value, value + (std::uint64_t(1) << 32), std::memory_order_acq_rel))
+	  {
+	    chunk = static_cast<std::size_t>(value >> 32);
+	    return true;
+	  }
+	}
+	return false;
+      }
+
+      /** @brief Move the second half of the chunks of another worker to this one */
+      bool steal(const unsigned id)
+      {
+	for (unsigned i = 1; i < count; ++i)
+	{
+	  std::atomic<std::uint64_t>& range = slots[(id + i) % count].range;
+	  std::uint64_t value = range.load(std::memory_order_acquire);
+	  while ((value >> 32) < (value & 0xFFFFFFFF))
+	  {
+	    const std::uint64_t begin = value >> 32;
+	    const std::uint64_t end = value & 0xFFFFFFFF;
+	    const std::uint64_t middle = begin + (end - begin) / 2;
+	    if (range.compare_exchange_weak(value, begin << 32 | middle, std::memory_order_acq_rel))
+	    {
+	      // Nobody changes an empty range, this worker's one is empty
+	      slots[id].range.store(middle << 32 | end, std::memory_order_release);
+	      return true;
+	    }
+	  }
+	}
+	return false;
+      }
+  };
+
+}
+
+#endif // WORKPOOL_HPP